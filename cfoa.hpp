@@ -38,6 +38,7 @@
 #include <limits>
 #include <memory>
 #include <mutex>
+#include <new>
 #include <shared_mutex>
 #include <tuple>
 #include <type_traits>
@@ -49,11 +50,44 @@
     defined(_M_X64)||(defined(_M_IX86_FP)&&_M_IX86_FP>=2)
 #define BOOST_UNORDERED_SSE2
 #include <emmintrin.h>
+#if defined(__AVX2__)
+#define BOOST_UNORDERED_AVX2
+#include <immintrin.h>
+#endif
+#if defined(__AVX512BW__)
+#define BOOST_UNORDERED_AVX512BW
+#endif
 #elif defined(__ARM_NEON)&&!defined(__ARM_BIG_ENDIAN)
 #define BOOST_UNORDERED_LITTLE_ENDIAN_NEON
 #include <arm_neon.h>
 #endif
 
+#if defined(BOOST_UNORDERED_CFOA_ENABLE_STATS)
+#include <chrono>
+#define BOOST_UNORDERED_CFOA_STATS(...) __VA_ARGS__
+#else
+#define BOOST_UNORDERED_CFOA_STATS(...) ((void)0)
+#endif
+
+#if defined(__unix__)||defined(__APPLE__)
+#define BOOST_UNORDERED_CFOA_HAS_MMAP
+#include <boost/throw_exception.hpp>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#endif
+
+#if !defined(BOOST_NO_CXX17_HDR_EXECUTION)
+#define BOOST_UNORDERED_PARALLEL_ALGORITHMS
+#include <algorithm>
+#include <execution>
+#endif
+
 #ifdef __has_builtin
 #define BOOST_UNORDERED_HAS_BUILTIN(x) __has_builtin(x)
 #else
@@ -116,9 +150,10 @@ static const std::size_t default_bucket_count = 0;
  *   |ofw|h14|h13|h13|h11|h10|h09|h08|h07|h06|h05|h04|h03|h02|h01|h00|
  *   +---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+---+
  *
- * hi is 0 if the i-th element slot is avalaible, 1 to mark a sentinel and,
- * when the slot is occupied, a value in the range [2,255] obtained from the
- * element's original hash value.
+ * hi is 0 if the i-th element slot is avalaible, 1 to mark a slot claimed by
+ * an insertion in progress (see group15::claim) and, when the slot is
+ * occupied, a value in the range [2,255] obtained from the element's original
+ * hash value.
  * ofw is the so-called overflow byte. If insertion of an element with hash
  * value h is tried on a full group, then the (h%8)-th bit of the overflow
  * byte is set to 1 and a further group is probed. Having an overflow byte
@@ -151,11 +186,44 @@ static const std::size_t default_bucket_count = 0;
  * metadata to all zeros.
  */
 
+/* group_access holds the synchronization data associated to a group:
+ *
+ *   - mtx, a reader-writer lock.
+ *   - cnt, a counter of insertions started at the group, used by
+ *     table::emplace_impl to detect concurrent insertions of the same element.
+ *   - ver, a seqlock-style version number incremented when the group is
+ *     exclusively locked and again when it's unlocked, so that it's odd while
+ *     a writer is modifying the group. This allows for optimistic lookup
+ *     (see table::optimistic_find_impl): readers record the version, inspect
+ *     the group without writing to shared memory and validate the version
+ *     afterwards.
+ */
+
 struct group_access
 {
   struct dummy_group_access_type
   {
-    boost::uint32_t storage[2]={0,0};
+    boost::uint32_t storage[3]={0,0,0};
+  };
+
+  struct exclusive_lock_guard
+  {
+    exclusive_lock_guard(group_access& x_):x{x_}
+    {
+      x.mtx.lock();
+      x.ver.store(
+        x.ver.load(std::memory_order_relaxed)+1,std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    ~exclusive_lock_guard()
+    {
+      x.ver.store(
+        x.ver.load(std::memory_order_relaxed)+1,std::memory_order_release);
+      x.mtx.unlock();
+    }
+
+    group_access& x;
   };
 
   inline auto shared_access()
@@ -163,16 +231,19 @@ struct group_access
     return std::shared_lock<rw_spinlock>(mtx);
   }
 
-  inline auto exclusive_access()
+  inline exclusive_lock_guard exclusive_access()
   {
-    return std::scoped_lock<rw_spinlock>(mtx);
+    return {*this};
   }
 
   inline auto& counter(){return cnt;}
 
+  inline auto& version(){return ver;}
+
 private:
   rw_spinlock          mtx;
   std::atomic_uint32_t cnt;
+  std::atomic_uint32_t ver;
 };
 
 template<typename Group>
@@ -227,9 +298,45 @@ struct group15
     at(pos)=available_;
   }
 
+  /* busy slots (claimed but not yet published) don't count as occupied */
+
+  inline bool is_occupied(std::size_t pos)const
+  {
+    BOOST_ASSERT(pos<N);
+    return at(pos).load(std::memory_order_acquire)>busy_;
+  }
+
   static inline void reset(unsigned char* pc)
   {
-    *pc=available_;
+    std::size_t pos=reinterpret_cast<uintptr_t>(pc)%sizeof(group15);
+    group15    *pg=reinterpret_cast<group15*>(pc-pos);
+    pg->at(pos).store(available_,std::memory_order_release);
+  }
+
+  /* Lock-free insertion (see table::emplace_with_hash): claim atomically
+   * turns an available slot into a busy one, which is neither available nor
+   * matched by any hash nor reported by match_occupied, and publish sets the
+   * reduced hash once the element has been constructed.
+   */
+
+  inline bool claim(std::size_t pos)
+  {
+    BOOST_ASSERT(pos<N);
+    unsigned char expected=available_;
+    return at(pos).compare_exchange_strong(expected,busy_);
+  }
+
+  inline void publish(std::size_t pos,std::size_t hash)
+  {
+    BOOST_ASSERT(pos<N);
+    at(pos).store(reduced_hash(hash),std::memory_order_release);
+  }
+
+  inline int match_busy()const
+  {
+    auto w=_mm_load_si128(reinterpret_cast<const __m128i*>(m));
+    return _mm_movemask_epi8(
+      _mm_cmpeq_epi8(w,_mm_set1_epi8((char)busy_)))&0x7FFF;
   }
 
   inline int match(std::size_t hash)const
@@ -267,12 +374,18 @@ struct group15
 
   inline int match_occupied()const
   {
-    return (~match_available())&0x7FFF;
+    /* slots with metadata > busy_, i.e. neither available nor busy */
+    auto w=_mm_load_si128(reinterpret_cast<const __m128i*>(m));
+    return (~_mm_movemask_epi8(_mm_cmpeq_epi8(
+      _mm_min_epu8(w,_mm_set1_epi8((char)busy_)),w)))&0x7FFF;
   }
 
 private:
+  friend struct group31;
+  friend struct group63;
+
   static constexpr unsigned char available_=0,
-                                 sentinel_=1;
+                                 busy_=1;
 
   inline static int match_word(std::size_t hash)
   {
@@ -333,200 +446,851 @@ private:
   alignas(16) std::atomic_uchar m[16];
 };
 
-#elif defined(BOOST_UNORDERED_LITTLE_ENDIAN_NEON)
+#if defined(BOOST_UNORDERED_AVX2)
 
-#error Neon not supported yet
+/* group31 and group63 are wide variants of group15 with N=31 and N=63 slots
+ * (32B and 64B metadata words, matched with AVX2 and AVX-512BW, respectively).
+ * The overflow byte is the last one of the metadata word and has the same
+ * semantics as in group15, and so do reduced hash values. Wider groups make it
+ * much less likely that a lookup needs to probe a second group at high loads,
+ * at the expense of more reduced-hash false matches per group and larger
+ * groups to prefetch.
+ */
 
-#else /* non-SIMD */
+struct group31
+{
+  static constexpr int N=31;
 
-#error Non-SIMD not supported yet
+  struct dummy_group_type
+  {
+    alignas(32) unsigned char storage[N+1]={};
+  };
 
-#endif
+  inline void initialize()
+  {
+    _mm256_store_si256(
+      reinterpret_cast<__m256i*>(m),_mm256_setzero_si256());
+  }
 
-/* foa::table uses a size policy to obtain the permissible sizes of the group
- * array (and, by implication, the element array) and to do the hash->group
- * mapping.
- * 
- *   - size_index(n) returns an unspecified "index" number used in other policy
- *     operations.
- *   - size(size_index_) returns the number of groups for the given index. It is
- *     guaranteed that size(size_index(n)) >= n.
- *   - min_size() is the minimum number of groups permissible, i.e.
- *     size(size_index(0)).
- *   - position(hash,size_index_) maps hash to a position in the range
- *     [0,size(size_index_)).
- * 
- * The reason we're introducing the intermediate index value for calculating
- * sizes and positions is that it allows us to optimize the implementation of
- * position, which is in the hot path of lookup and insertion operations:
- * pow2_size_policy, the actual size policy used by foa::table, returns 2^n
- * (n>0) as permissible sizes and returns the n most significant bits
- * of the hash value as the position in the group array; using a size index
- * defined as i = (bits in std::size_t) - n, we have an unbeatable
- * implementation of position(hash) as hash>>i.
- * There's a twofold reason for choosing the high bits of hash for positioning:
- *   - Multiplication-based mixing tends to yield better entropy in the high
- *     part of its result.
- *   - group15 reduced-hash values take the *low* bits of hash, and we want
- *     these values and positioning to be as uncorrelated as possible.
- */
+  inline std::atomic_uchar& at(std::size_t pos)
+  {
+    return m[pos];
+  }
 
-struct pow2_size_policy
-{
-  static inline std::size_t size_index(std::size_t n)
+  inline const std::atomic_uchar& at(std::size_t pos)const
   {
-    // TODO: min size is 2, see if we can bring it down to 1 without loss
-    // of performance
+    return m[pos];
+  }
 
-    return sizeof(std::size_t)*CHAR_BIT-
-      (n<=2?1:((std::size_t)(boost::core::bit_width(n-1))));
+  inline void set(std::size_t pos,std::size_t hash)
+  {
+    BOOST_ASSERT(pos<N);
+    at(pos)=group15::reduced_hash(hash);
   }
 
-  static inline std::size_t size(std::size_t size_index_)
+  inline void reset(std::size_t pos)
   {
-     return std::size_t(1)<<(sizeof(std::size_t)*CHAR_BIT-size_index_);  
+    BOOST_ASSERT(pos<N);
+    at(pos)=group15::available_;
   }
-    
-  static constexpr std::size_t min_size(){return 2;}
 
-  static inline std::size_t position(std::size_t hash,std::size_t size_index_)
+  static inline void reset(unsigned char* pc)
   {
-    return hash>>size_index_;
+    std::size_t pos=reinterpret_cast<uintptr_t>(pc)%sizeof(group31);
+    group31    *pg=reinterpret_cast<group31*>(pc-pos);
+    pg->at(pos).store(group15::available_,std::memory_order_release);
   }
-};
 
-/* size index of a group array for a given *element* capacity */
+  inline bool is_occupied(std::size_t pos)const
+  {
+    BOOST_ASSERT(pos<N);
+    return at(pos).load(std::memory_order_acquire)>group15::busy_;
+  }
 
-template<typename Group,typename SizePolicy>
-static inline std::size_t size_index_for(std::size_t n)
-{
-  /* n/N+1 == ceil((n+1)/N) (extra +1 for the sentinel) */
-  return SizePolicy::size_index(n/Group::N+1);
-}
+  inline bool claim(std::size_t pos)
+  {
+    BOOST_ASSERT(pos<N);
+    unsigned char expected=group15::available_;
+    return at(pos).compare_exchange_strong(expected,group15::busy_);
+  }
 
-/* Quadratic prober over a power-of-two range using triangular numbers.
- * mask in next(mask) must be the range size minus one (and since size is 2^n,
- * mask has exactly its n first bits set to 1).
- */
+  inline void publish(std::size_t pos,std::size_t hash)
+  {
+    BOOST_ASSERT(pos<N);
+    at(pos).store(group15::reduced_hash(hash),std::memory_order_release);
+  }
 
-struct pow2_quadratic_prober
-{
-  pow2_quadratic_prober(std::size_t pos_):pos{pos_}{}
+  inline int match_busy()const
+  {
+    auto w=_mm256_load_si256(reinterpret_cast<const __m256i*>(m));
+    return _mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(w,_mm256_set1_epi8((char)group15::busy_)))&
+      0x7FFFFFFF;
+  }
 
-  inline std::size_t get()const{return pos;}
+  inline int match(std::size_t hash)const
+  {
+    auto w=_mm256_load_si256(reinterpret_cast<const __m256i*>(m));
+    return _mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(w,_mm256_set1_epi32(group15::match_word(hash))))&
+      0x7FFFFFFF;
+  }
 
-  /* next returns false when the whole array has been traversed, which ends
-   * probing (in practice, full-table probing will only happen with very small
-   * arrays).
-   */
+  inline bool is_not_overflowed(std::size_t hash)const
+  {
+    return !(overflow()&(1u<<(hash%8)));
+  }
 
-  inline bool next(std::size_t mask)
+  inline void mark_overflow(std::size_t hash)
   {
-    step+=1;
-    pos=(pos+step)&mask;
-    return step<=mask;
+    overflow()|=static_cast<unsigned char>(1<<(hash%8));
   }
 
-private:
-  std::size_t pos,step=0;
-};
+  static inline bool maybe_caused_overflow(unsigned char* pc)
+  {
+    std::size_t pos=reinterpret_cast<uintptr_t>(pc)%sizeof(group31);
+    group31    *pg=reinterpret_cast<group31*>(pc-pos);
+    return !pg->is_not_overflowed(*pc);
+  };
 
-/* Mixing policies: no_mix is the identity function and xmx_mix uses the
- * xmx function defined in <boost/unordered/detail/xmx.hpp>.
- * foa::table mixes hash results with xmx_mix unless the hash is marked as
- * avalanching, i.e. of good quality (see <boost/unordered/hash_traits.hpp>).
- */
+  inline int match_available()const
+  {
+    auto w=_mm256_load_si256(reinterpret_cast<const __m256i*>(m));
+    return _mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(w,_mm256_setzero_si256()))&0x7FFFFFFF;
+  }
 
-struct no_mix
-{
-  template<typename Hash,typename T>
-  static inline std::size_t mix(const Hash& h,const T& x)
+  inline int match_occupied()const
   {
-    return h(x);
+    auto w=_mm256_load_si256(reinterpret_cast<const __m256i*>(m));
+    return (~_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+      _mm256_min_epu8(w,_mm256_set1_epi8((char)group15::busy_)),w)))&
+      0x7FFFFFFF;
   }
-};
 
-struct xmx_mix
-{
-  template<typename Hash,typename T>
-  static inline std::size_t mix(const Hash& h,const T& x)
+private:
+  inline std::atomic_uchar& overflow()
   {
-    return xmx(h(x));
+    return at(N);
   }
-};
 
-/* boost::core::countr_zero has a potentially costly check for
- * the case x==0.
- */
+  inline const std::atomic_uchar& overflow()const
+  {
+    return at(N);
+  }
+
+  alignas(32) std::atomic_uchar m[32];
+};
 
-inline unsigned int unchecked_countr_zero(int x)
-{
-#if defined(BOOST_MSVC)
-  unsigned long r;
-  _BitScanForward(&r,(unsigned long)x);
-  return (unsigned int)r;
-#else
-  BOOST_UNORDERED_ASSUME(x!=0);
-  return (unsigned int)boost::core::countr_zero((unsigned int)x);
 #endif
-}
 
-template<typename,typename,typename,typename,typename>
-class table;
+#if defined(BOOST_UNORDERED_AVX512BW)
 
-/* table_iterator keeps two pointers:
- * 
- *   - A pointer p to the element slot.
- *   - A pointer pc to the n-th byte of the associated group metadata, where n
- *     is the position of the element in the group.
- *
- * A simpler solution would have been to keep a pointer p to the element, a
- * pointer pg to the group, and the position n, but that would increase
- * sizeof(table_iterator) by 4/8 bytes. In order to make this compact
- * representation feasible, it is required that group objects are aligned
- * to their size, so that we can recover pg and n as
- * 
- *   - n = pc%sizeof(group)
- *   - pg = pc-n
- * 
- * (for explanatory purposes pg and pc are treated above as if they were memory
- * addresses rather than pointers).The main drawback of this two-pointer
- * representation is that iterator increment is relatively slow.
- * 
- * p = nullptr is conventionally used to mark end() iterators.
- *
- * TypePolicy encodes the element type and the actual value_type, which are
- * different for node containers. See below for a full explanation of type
- * policies.
+/* group63 bitmasks don't fit in an int: table code handles them through auto
+ * and the boost::uint64_t overload of unchecked_countr_zero.
  */
 
-/* internal conversion from const_iterator to iterator */
-class const_iterator_cast_tag {}; 
-
-template<typename TypePolicy,typename Group,bool Const>
-class table_iterator
+struct group63
 {
-  using type_policy=TypePolicy;
+  static constexpr int N=63;
 
-  /* "element_type" is taken by the homonym pointer trait */
-  using table_element_type=typename type_policy::element_type;
+  struct dummy_group_type
+  {
+    alignas(64) unsigned char storage[N+1]={};
+  };
 
-public:
-  using difference_type=std::ptrdiff_t;
-  using value_type=typename type_policy::value_type;
-  using pointer=
-    typename std::conditional<Const,value_type const*,value_type*>::type;
-  using reference=
-    typename std::conditional<Const,value_type const&,value_type&>::type;
-  using iterator_category=std::forward_iterator_tag;
-  using element_type=
-    typename std::conditional<Const,value_type const,value_type>::type;
+  inline void initialize()
+  {
+    _mm512_store_si512(
+      reinterpret_cast<__m512i*>(m),_mm512_setzero_si512());
+  }
 
-  table_iterator()=default;
-  template<bool Const2,typename std::enable_if<!Const2>::type* =nullptr>
-  table_iterator(const table_iterator<TypePolicy,Group,Const2>& x):
-    pc{x.pc},p{x.p}{}
-  table_iterator(
+  inline std::atomic_uchar& at(std::size_t pos)
+  {
+    return m[pos];
+  }
+
+  inline const std::atomic_uchar& at(std::size_t pos)const
+  {
+    return m[pos];
+  }
+
+  inline void set(std::size_t pos,std::size_t hash)
+  {
+    BOOST_ASSERT(pos<N);
+    at(pos)=group15::reduced_hash(hash);
+  }
+
+  inline void reset(std::size_t pos)
+  {
+    BOOST_ASSERT(pos<N);
+    at(pos)=group15::available_;
+  }
+
+  static inline void reset(unsigned char* pc)
+  {
+    std::size_t pos=reinterpret_cast<uintptr_t>(pc)%sizeof(group63);
+    group63    *pg=reinterpret_cast<group63*>(pc-pos);
+    pg->at(pos).store(group15::available_,std::memory_order_release);
+  }
+
+  inline bool is_occupied(std::size_t pos)const
+  {
+    BOOST_ASSERT(pos<N);
+    return at(pos).load(std::memory_order_acquire)>group15::busy_;
+  }
+
+  inline bool claim(std::size_t pos)
+  {
+    BOOST_ASSERT(pos<N);
+    unsigned char expected=group15::available_;
+    return at(pos).compare_exchange_strong(expected,group15::busy_);
+  }
+
+  inline void publish(std::size_t pos,std::size_t hash)
+  {
+    BOOST_ASSERT(pos<N);
+    at(pos).store(group15::reduced_hash(hash),std::memory_order_release);
+  }
+
+  inline boost::uint64_t match_busy()const
+  {
+    auto w=_mm512_load_si512(reinterpret_cast<const __m512i*>(m));
+    return _mm512_cmpeq_epi8_mask(
+      w,_mm512_set1_epi8((char)group15::busy_))&0x7FFFFFFFFFFFFFFFull;
+  }
+
+  inline boost::uint64_t match(std::size_t hash)const
+  {
+    auto w=_mm512_load_si512(reinterpret_cast<const __m512i*>(m));
+    return _mm512_cmpeq_epi8_mask(
+      w,_mm512_set1_epi32(group15::match_word(hash)))&
+      0x7FFFFFFFFFFFFFFFull;
+  }
+
+  inline bool is_not_overflowed(std::size_t hash)const
+  {
+    return !(overflow()&(1u<<(hash%8)));
+  }
+
+  inline void mark_overflow(std::size_t hash)
+  {
+    overflow()|=static_cast<unsigned char>(1<<(hash%8));
+  }
+
+  static inline bool maybe_caused_overflow(unsigned char* pc)
+  {
+    std::size_t pos=reinterpret_cast<uintptr_t>(pc)%sizeof(group63);
+    group63    *pg=reinterpret_cast<group63*>(pc-pos);
+    return !pg->is_not_overflowed(*pc);
+  };
+
+  inline boost::uint64_t match_available()const
+  {
+    auto w=_mm512_load_si512(reinterpret_cast<const __m512i*>(m));
+    return _mm512_cmpeq_epi8_mask(w,_mm512_setzero_si512())&
+      0x7FFFFFFFFFFFFFFFull;
+  }
+
+  inline boost::uint64_t match_occupied()const
+  {
+    auto w=_mm512_load_si512(reinterpret_cast<const __m512i*>(m));
+    return _mm512_cmpgt_epu8_mask(
+      w,_mm512_set1_epi8((char)group15::busy_))&0x7FFFFFFFFFFFFFFFull;
+  }
+
+private:
+  inline std::atomic_uchar& overflow()
+  {
+    return at(N);
+  }
+
+  inline const std::atomic_uchar& overflow()const
+  {
+    return at(N);
+  }
+
+  alignas(64) std::atomic_uchar m[64];
+};
+
+#endif
+
+#endif
+
+/* swar_group15 implements the non-SIMD, bit-interleaved layout described
+ * above: the i-th bit of each metadata byte is held at positions 16*(i%4)+n
+ * of m[i/4], where n is the position of the byte within the group. As
+ * the overflow byte shares the 64-bit words with the slots' reduced hashes
+ * and mark_overflow is executed without any lock, all modifications are done
+ * by atomic RMW operations on the affected words. Reads are not atomic as a
+ * whole (m[0] and m[1] are loaded separately), which gives the same
+ * guarantees as byte-wise access in the SIMD group: a slot being written to
+ * may be seen with a transient value, which table re-checks under the group
+ * lock via is_occupied.
+ *
+ * swar_group15 is available in all platforms so that it can be benchmarked
+ * against the SIMD version; it's the default group15 when SSE2 is not
+ * available (including little-endian Neon, pending a dedicated
+ * implementation).
+ */
+
+struct swar_group15
+{
+  static constexpr int N=15;
+
+  struct dummy_group_type
+  {
+    alignas(16) boost::uint64_t storage[2]={0,0};
+  };
+
+  inline void initialize()
+  {
+    m[0].store(0,std::memory_order_relaxed);
+    m[1].store(0,std::memory_order_relaxed);
+  }
+
+  inline void set(std::size_t pos,std::size_t hash)
+  {
+    BOOST_ASSERT(pos<N);
+    set_impl(pos,reduced_hash(hash));
+  }
+
+  inline void reset(std::size_t pos)
+  {
+    BOOST_ASSERT(pos<N);
+    set_impl(pos,available_);
+  }
+
+  static inline void reset(unsigned char* pc)
+  {
+    std::size_t pos=reinterpret_cast<uintptr_t>(pc)%sizeof(swar_group15);
+    reinterpret_cast<swar_group15*>(pc-pos)->reset(pos);
+  }
+
+  inline bool is_occupied(std::size_t pos)const
+  {
+    BOOST_ASSERT(pos<N);
+    return match_occupied()&(1u<<pos);
+  }
+
+  inline int match(std::size_t hash)const
+  {
+    return match_impl(reduced_hash(hash));
+  }
+
+  inline bool is_not_overflowed(std::size_t hash)const
+  {
+    return !(m[(hash%8)/4].load(std::memory_order_relaxed)&
+             overflow_bit(hash));
+  }
+
+  inline void mark_overflow(std::size_t hash)
+  {
+    m[(hash%8)/4].fetch_or(overflow_bit(hash),std::memory_order_relaxed);
+  }
+
+  static inline bool maybe_caused_overflow(unsigned char* pc)
+  {
+    std::size_t   pos=reinterpret_cast<uintptr_t>(pc)%sizeof(swar_group15);
+    swar_group15 *pg=reinterpret_cast<swar_group15*>(pc-pos);
+
+    /* low three bits of the reduced hash, which is invariant under modulo 8 */
+    boost::uint64_t x=
+      (pg->m[0].load(std::memory_order_relaxed)>>pos)&0x000100010001ull;
+    boost::uint32_t y=narrow_cast<boost::uint32_t>(x|(x>>15)|(x>>30));
+    return !pg->is_not_overflowed(y);
+  }
+
+  inline int match_available()const
+  {
+    boost::uint64_t x=~(m[0].load(std::memory_order_relaxed)|
+                        m[1].load(std::memory_order_relaxed));
+    boost::uint32_t y=narrow_cast<boost::uint32_t>(x&(x>>32));
+    y&=y>>16;
+    return y&0x7FFF;
+  }
+
+  inline int match_occupied()const
+  {
+    boost::uint64_t x=m[0].load(std::memory_order_relaxed)|
+                      m[1].load(std::memory_order_relaxed);
+    boost::uint32_t y=narrow_cast<boost::uint32_t>(x|(x>>32));
+    y|=y>>16;
+    return y&0x7FFF;
+  }
+
+private:
+  static constexpr unsigned char available_=0,
+                                 sentinel_=1;
+
+  inline static unsigned char reduced_hash(std::size_t hash)
+  {
+    /* same mapping as group15: 0 and 1 are reserved, so they're sent to
+     * 8 and 9, respectively, to keep invariance under modulo 8
+     */
+
+    auto h=narrow_cast<unsigned char>(hash);
+    return narrow_cast<unsigned char>(h+((h<2)<<3));
+  }
+
+  inline static boost::uint64_t overflow_bit(std::size_t hash)
+  {
+    return boost::uint64_t(0x8000u)<<(16*(hash%4));
+  }
+
+  inline void set_impl(std::size_t pos,std::size_t n)
+  {
+    BOOST_ASSERT(n<256);
+    set_impl(m[0],pos,n&0xFu);
+    set_impl(m[1],pos,n>>4);
+  }
+
+  static inline void set_impl(
+    std::atomic<boost::uint64_t>& x,std::size_t pos,std::size_t n)
+  {
+    static constexpr boost::uint64_t mask[]=
+    {
+      0x0000000000000000ull,0x0000000000000001ull,0x0000000000010000ull,
+      0x0000000000010001ull,0x0000000100000000ull,0x0000000100000001ull,
+      0x0000000100010000ull,0x0000000100010001ull,0x0001000000000000ull,
+      0x0001000000000001ull,0x0001000000010000ull,0x0001000000010001ull,
+      0x0001000100000000ull,0x0001000100000001ull,0x0001000100010000ull,
+      0x0001000100010001ull,
+    };
+
+    BOOST_ASSERT(pos<16&&n<16);
+    x.fetch_or(mask[n]<<pos,std::memory_order_relaxed);
+    x.fetch_and(~(mask[~n&0xFu]<<pos),std::memory_order_relaxed);
+  }
+
+  inline int match_impl(std::size_t n)const
+  {
+    static constexpr boost::uint64_t mask[]=
+    {
+      0x0000000000000000ull,0x000000000000ffffull,0x00000000ffff0000ull,
+      0x00000000ffffffffull,0x0000ffff00000000ull,0x0000ffff0000ffffull,
+      0x0000ffffffff0000ull,0x0000ffffffffffffull,0xffff000000000000ull,
+      0xffff00000000ffffull,0xffff0000ffff0000ull,0xffff0000ffffffffull,
+      0xffffffff00000000ull,0xffffffff0000ffffull,0xffffffffffff0000ull,
+      0xffffffffffffffffull,
+    };
+
+    BOOST_ASSERT(n<256);
+    boost::uint64_t x=m[0].load(std::memory_order_relaxed)^mask[n&0xFu];
+                    x=~((m[1].load(std::memory_order_relaxed)^mask[n>>4])|x);
+    boost::uint32_t y=narrow_cast<boost::uint32_t>(x&(x>>32));
+                    y&=y>>16;
+    return          y&0x7FFF;
+  }
+
+  alignas(16) std::atomic<boost::uint64_t> m[2];
+};
+
+#if !defined(BOOST_UNORDERED_SSE2)
+using group15=swar_group15;
+#endif
+
+/* foa::table uses a size policy to obtain the permissible sizes of the group
+ * array (and, by implication, the element array) and to do the hash->group
+ * mapping.
+ * 
+ *   - size_index(n) returns an unspecified "index" number used in other policy
+ *     operations.
+ *   - size(size_index_) returns the number of groups for the given index. It is
+ *     guaranteed that size(size_index(n)) >= n.
+ *   - min_size() is the minimum number of groups permissible, i.e.
+ *     size(size_index(0)).
+ *   - position(hash,size_index_) maps hash to a position in the range
+ *     [0,size(size_index_)).
+ * 
+ * The reason we're introducing the intermediate index value for calculating
+ * sizes and positions is that it allows us to optimize the implementation of
+ * position, which is in the hot path of lookup and insertion operations:
+ * pow2_size_policy, the actual size policy used by foa::table, returns 2^n
+ * (n>0) as permissible sizes and returns the n most significant bits
+ * of the hash value as the position in the group array; using a size index
+ * defined as i = (bits in std::size_t) - n, we have an unbeatable
+ * implementation of position(hash) as hash>>i.
+ * There's a twofold reason for choosing the high bits of hash for positioning:
+ *   - Multiplication-based mixing tends to yield better entropy in the high
+ *     part of its result.
+ *   - group15 reduced-hash values take the *low* bits of hash, and we want
+ *     these values and positioning to be as uncorrelated as possible.
+ */
+
+struct pow2_size_policy
+{
+  static inline std::size_t size_index(std::size_t n)
+  {
+    // TODO: min size is 2, see if we can bring it down to 1 without loss
+    // of performance
+
+    return sizeof(std::size_t)*CHAR_BIT-
+      (n<=2?1:((std::size_t)(boost::core::bit_width(n-1))));
+  }
+
+  static inline std::size_t size(std::size_t size_index_)
+  {
+     return std::size_t(1)<<(sizeof(std::size_t)*CHAR_BIT-size_index_);  
+  }
+    
+  static constexpr std::size_t min_size(){return 2;}
+
+  static inline std::size_t position(std::size_t hash,std::size_t size_index_)
+  {
+    return hash>>size_index_;
+  }
+};
+
+/* size index of a group array for a given *element* capacity */
+
+template<typename Group,typename SizePolicy>
+static inline std::size_t size_index_for(std::size_t n)
+{
+  /* n/N+1 == ceil((n+1)/N) (extra +1 for the sentinel) */
+  return SizePolicy::size_index(n/Group::N+1);
+}
+
+/* Quadratic prober over a power-of-two range using triangular numbers.
+ * mask in next(mask) must be the range size minus one (and since size is 2^n,
+ * mask has exactly its n first bits set to 1).
+ */
+
+struct pow2_quadratic_prober
+{
+  pow2_quadratic_prober(std::size_t pos_):pos{pos_}{}
+
+  inline std::size_t get()const{return pos;}
+  inline std::size_t length()const{return step+1;}
+
+  /* next returns false when the whole array has been traversed, which ends
+   * probing (in practice, full-table probing will only happen with very small
+   * arrays).
+   */
+
+  inline bool next(std::size_t mask)
+  {
+    step+=1;
+    pos=(pos+step)&mask;
+    return step<=mask;
+  }
+
+private:
+  std::size_t pos,step=0;
+};
+
+#if defined(BOOST_UNORDERED_CFOA_ENABLE_STATS)
+/* Statistics returned by table::get_stats() when
+ * BOOST_UNORDERED_CFOA_ENABLE_STATS is defined. Probe lengths are measured
+ * in groups visited, as reported by pow2_quadratic_prober::length(); the last
+ * histogram bucket accumulates all longer probes. false_matches counts
+ * reduced-hash matches rejected on lookup, startovers the insertions retried
+ * because another thread inserted from the same initial group, and
+ * overflow_bits_set the overflow bits turned from 0 to 1. rehash_time covers
+ * incremental migrations from start to completion.
+ */
+
+static constexpr std::size_t stats_probe_length_buckets=16;
+
+struct table_stats
+{
+  std::size_t              lookup_probe_lengths[stats_probe_length_buckets]={};
+  std::size_t              insertion_probe_lengths[stats_probe_length_buckets]={};
+  std::size_t              false_matches=0;
+  std::size_t              startovers=0;
+  std::size_t              overflow_bits_set=0;
+  std::size_t              rehashes=0;
+  std::chrono::nanoseconds rehash_time{0};
+};
+#endif
+
+#if defined(BOOST_UNORDERED_CFOA_HAS_MMAP)
+/* Binary image written by table::save_image: a header followed by the element
+ * slots, the group metadata and an arena with the data elements refer to out
+ * of line (e.g. key characters), each section page-aligned. Elements are
+ * prelinked for the image being mapped at base_address, so that a load
+ * obtaining that address needs no fix-ups at all.
+ */
+
+struct table_image_header
+{
+  char          magic[8];
+  boost::uint64_t element_size;
+  boost::uint64_t group_size;
+  boost::uint64_t groups_size_index;
+  boost::uint64_t groups_size_mask;
+  boost::uint64_t size;
+  boost::uint64_t ml;
+  boost::uint64_t elements_offset;
+  boost::uint64_t groups_offset;
+  boost::uint64_t arena_offset;
+  boost::uint64_t image_size;
+  boost::uint64_t base_address;
+};
+
+static constexpr char          table_image_magic[8]={
+                                 'c','f','o','a','i','m','g','1'};
+static constexpr std::size_t   table_image_page_size=4096;
+static constexpr boost::uint64_t table_image_base_address=
+                                 sizeof(void*)==8?0x600000000000ull:0;
+
+inline boost::uint64_t table_image_align(boost::uint64_t n)
+{
+  return (n+table_image_page_size-1)/table_image_page_size*
+         table_image_page_size;
+}
+
+/* whether n objects of the given size starting at offset lie within
+ * image_size bytes, with no overflow
+ */
+
+inline bool table_image_fits(
+  boost::uint64_t offset,boost::uint64_t n,boost::uint64_t size,
+  boost::uint64_t image_size)
+{
+  return offset<=image_size&&(size==0||n<=(image_size-offset)/size);
+}
+
+[[noreturn]] inline void throw_table_image_error(
+  int ev,const char* filename)
+{
+  boost::throw_exception(
+    std::system_error(ev,std::generic_category(),filename));
+}
+
+struct table_image_file
+{
+  table_image_file(const char* filename_):
+    filename{filename_},f{std::fopen(filename,"wb")}
+  {
+    if(!f)throw_table_image_error(errno,filename);
+  }
+
+  ~table_image_file(){if(f)std::fclose(f);}
+
+  void write(boost::uint64_t pos,const void* p,std::size_t n)
+  {
+    if(std::fseek(f,long(pos),SEEK_SET)!=0||
+       std::fwrite(p,1,n,f)!=n){
+      throw_table_image_error(errno,filename);
+    }
+  }
+
+  void close(boost::uint64_t size)
+  {
+    /* pads unwritten trailing sections (e.g. an empty arena) with zeros */
+    auto res=std::fclose(f);
+    f=nullptr;
+    if(res!=0||::truncate(filename,off_t(size))!=0){
+      throw_table_image_error(errno,filename);
+    }
+  }
+
+  const char* filename;
+  std::FILE*  f;
+};
+
+/* Private copy-on-write mapping of a table image, paged in lazily. */
+
+class table_image_mapping
+{
+public:
+  table_image_mapping()=default;
+
+  explicit table_image_mapping(const char* filename)
+  {
+    int fd=::open(filename,O_RDONLY);
+    if(fd<0)throw_table_image_error(errno,filename);
+
+    struct ::stat st;
+    if(::fstat(fd,&st)!=0){
+      int ev=errno;
+      ::close(fd);
+      throw_table_image_error(ev,filename);
+    }
+    len=std::size_t(st.st_size);
+    if(len<sizeof(table_image_header)){
+      ::close(fd);
+      throw_table_image_error(EINVAL,filename);
+    }
+
+    table_image_header hdr;
+    if(::pread(fd,&hdr,sizeof(hdr),0)!=ssize_t(sizeof(hdr))){
+      int ev=errno;
+      ::close(fd);
+      throw_table_image_error(ev,filename);
+    }
+    /* sections are page aligned and laid out in this order after the header;
+     * their extents are checked by table::load_image, which knows the
+     * element and group sizes
+     */
+    if(std::memcmp(hdr.magic,table_image_magic,sizeof(hdr.magic))!=0||
+       hdr.image_size>len||
+       hdr.elements_offset<sizeof(hdr)||
+       hdr.elements_offset>hdr.groups_offset||
+       hdr.groups_offset>hdr.arena_offset||
+       hdr.arena_offset>hdr.image_size||
+       hdr.elements_offset%table_image_page_size!=0||
+       hdr.groups_offset%table_image_page_size!=0||
+       hdr.arena_offset%table_image_page_size!=0){
+      ::close(fd);
+      throw_table_image_error(EINVAL,filename);
+    }
+
+    /* the base address is only a hint: we may get the mapping elsewhere */
+    addr=::mmap(
+      reinterpret_cast<void*>(std::uintptr_t(hdr.base_address)),len,
+      PROT_READ|PROT_WRITE,MAP_PRIVATE,fd,0);
+    int ev=errno;
+    ::close(fd);
+    if(addr==MAP_FAILED){
+      addr=nullptr;
+      throw_table_image_error(ev,filename);
+    }
+  }
+
+  table_image_mapping(table_image_mapping&& x)noexcept:
+    addr{x.addr},len{x.len}
+  {
+    x.addr=nullptr;
+    x.len=0;
+  }
+
+  table_image_mapping& operator=(table_image_mapping&& x)noexcept
+  {
+    std::swap(addr,x.addr);
+    std::swap(len,x.len);
+    return *this;
+  }
+
+  ~table_image_mapping(){if(addr)::munmap(addr,len);}
+
+  const table_image_header& header()const
+  {
+    return *static_cast<const table_image_header*>(addr);
+  }
+
+  unsigned char* data()const{return static_cast<unsigned char*>(addr);}
+
+  bool contains(const void* p)const
+  {
+    return addr&&p>=addr&&p<static_cast<const unsigned char*>(addr)+len;
+  }
+
+private:
+  void*       addr=nullptr;
+  std::size_t len=0;
+};
+#endif
+
+/* Mixing policies: no_mix is the identity function and xmx_mix uses the
+ * xmx function defined in <boost/unordered/detail/xmx.hpp>.
+ * foa::table mixes hash results with xmx_mix unless the hash is marked as
+ * avalanching, i.e. of good quality (see <boost/unordered/hash_traits.hpp>).
+ */
+
+struct no_mix
+{
+  template<typename Hash,typename T>
+  static inline std::size_t mix(const Hash& h,const T& x)
+  {
+    return h(x);
+  }
+};
+
+struct xmx_mix
+{
+  template<typename Hash,typename T>
+  static inline std::size_t mix(const Hash& h,const T& x)
+  {
+    return xmx(h(x));
+  }
+};
+
+/* boost::core::countr_zero has a potentially costly check for
+ * the case x==0.
+ */
+
+inline unsigned int unchecked_countr_zero(int x)
+{
+#if defined(BOOST_MSVC)
+  unsigned long r;
+  _BitScanForward(&r,(unsigned long)x);
+  return (unsigned int)r;
+#else
+  BOOST_UNORDERED_ASSUME(x!=0);
+  return (unsigned int)boost::core::countr_zero((unsigned int)x);
+#endif
+}
+
+inline unsigned int unchecked_countr_zero(boost::uint64_t x)
+{
+#if defined(BOOST_MSVC)&&defined(_M_X64)
+  unsigned long r;
+  _BitScanForward64(&r,x);
+  return (unsigned int)r;
+#else
+  BOOST_UNORDERED_ASSUME(x!=0);
+  return (unsigned int)boost::core::countr_zero(x);
+#endif
+}
+
+template<typename,typename,typename,typename,typename,typename>
+class table;
+
+/* table_iterator keeps two pointers:
+ * 
+ *   - A pointer p to the element slot.
+ *   - A pointer pc to the n-th byte of the associated group metadata, where n
+ *     is the position of the element in the group.
+ *
+ * A simpler solution would have been to keep a pointer p to the element, a
+ * pointer pg to the group, and the position n, but that would increase
+ * sizeof(table_iterator) by 4/8 bytes. In order to make this compact
+ * representation feasible, it is required that group objects are aligned
+ * to their size, so that we can recover pg and n as
+ * 
+ *   - n = pc%sizeof(group)
+ *   - pg = pc-n
+ * 
+ * (for explanatory purposes pg and pc are treated above as if they were memory
+ * addresses rather than pointers).The main drawback of this two-pointer
+ * representation is that iterator increment is relatively slow.
+ * 
+ * p = nullptr is conventionally used to mark end() iterators.
+ *
+ * TypePolicy encodes the element type and the actual value_type, which are
+ * different for node containers. See below for a full explanation of type
+ * policies.
+ */
+
+/* internal conversion from const_iterator to iterator */
+class const_iterator_cast_tag {}; 
+
+template<typename TypePolicy,typename Group,bool Const>
+class table_iterator
+{
+  using type_policy=TypePolicy;
+
+  /* "element_type" is taken by the homonym pointer trait */
+  using table_element_type=typename type_policy::element_type;
+
+public:
+  using difference_type=std::ptrdiff_t;
+  using value_type=typename type_policy::value_type;
+  using pointer=
+    typename std::conditional<Const,value_type const*,value_type*>::type;
+  using reference=
+    typename std::conditional<Const,value_type const&,value_type&>::type;
+  using iterator_category=std::forward_iterator_tag;
+  using element_type=
+    typename std::conditional<Const,value_type const,value_type>::type;
+
+  table_iterator()=default;
+  template<bool Const2,typename std::enable_if<!Const2>::type* =nullptr>
+  table_iterator(const table_iterator<TypePolicy,Group,Const2>& x):
+    pc{x.pc},p{x.p}{}
+  table_iterator(
     const_iterator_cast_tag, const table_iterator<TypePolicy,Group,true>& x):
     pc{x.pc},p{x.p}{}
 
@@ -546,7 +1310,8 @@ public:
 
 private:
   template<typename,typename,bool> friend class table_iterator;
-  template<typename,typename,typename,typename,typename> friend class table;
+  template<typename,typename,typename,typename,typename,typename>
+  friend class table;
 
   table_iterator(Group* pg,std::size_t n,const table_element_type* p_):
     pc{reinterpret_cast<unsigned char*>(const_cast<Group*>(pg))+n},
@@ -564,7 +1329,7 @@ private:
   {
     std::size_t n0=rebase();
 
-    int mask=(reinterpret_cast<Group*>(pc)->match_occupied()>>(n0+1))<<(n0+1);
+    auto mask=(reinterpret_cast<Group*>(pc)->match_occupied()>>(n0+1))<<(n0+1);
     if(!mask){
       do{
         pc+=sizeof(Group);
@@ -615,7 +1380,41 @@ Group* dummy_groups()
     const_cast<typename Group::dummy_group_type*>(storage));
 }
 
-template<typename Element,typename Group,typename SizePolicy>
+/* table_arrays stores its pointers with the allocator's pointer type, so
+ * that tables can be placed in shared memory with allocators using offset
+ * pointers (e.g. those of Boost.Interprocess). Fancy pointers are wrapped into
+ * arrays_pointer, which converts implicitly to and from raw pointers, the
+ * only kind the rest of the code deals with.
+ */
+
+template<typename T,typename Pointer>
+class arrays_pointer
+{
+public:
+  arrays_pointer()=default;
+  arrays_pointer(std::nullptr_t){}
+  arrays_pointer(T* p_):
+    p{p_?boost::pointer_traits<Pointer>::pointer_to(*p_):Pointer()}{}
+
+  operator T*()const noexcept{return boost::to_address(p);}
+  T* operator->()const noexcept{return boost::to_address(p);}
+
+private:
+  Pointer p=Pointer();
+};
+
+template<typename T,typename VoidPointer>
+using arrays_pointer_t=typename std::conditional<
+  std::is_pointer<VoidPointer>::value,
+  T*,
+  arrays_pointer<
+    T,typename boost::pointer_traits<VoidPointer>::template rebind_to<T>::type>
+>::type;
+
+template<
+  typename Element,typename Group,typename SizePolicy,
+  typename VoidPointer=void*
+>
 struct table_arrays
 {
   using element_type=Element;
@@ -623,6 +1422,10 @@ struct table_arrays
   static constexpr auto N=group_type::N;
   using size_policy=SizePolicy;
 
+  /* dummy groups are process-local, so not usable with fancy pointers */
+
+  static constexpr bool use_dummy_groups=std::is_pointer<VoidPointer>::value;
+
   template<typename Allocator>
   static table_arrays new_(Allocator& al,std::size_t n)
   {
@@ -636,7 +1439,7 @@ struct table_arrays
     table_arrays arrays{groups_size_index,groups_size-1,nullptr,nullptr,nullptr};
 #endif
 
-    if(!n){
+    if(!n&&use_dummy_groups){
       arrays.groups=dummy_groups<group_type,size_policy::min_size()>();
     }
     else{
@@ -657,21 +1460,30 @@ struct table_arrays
        */
 
       std::memset(arrays.groups,0,sizeof(group_type)*groups_size);
+      new_group_accesses_(al,arrays);
+    }
+    return arrays;
+  }
 
+  template<typename Allocator>
+  static void new_group_accesses_(Allocator& al,table_arrays& arrays)
+  {
 #ifndef CFOA_EMBEDDED_GROUP_ACCESS
-      using group_access_allocator_type=
-        allocator_rebind_t<Allocator,group_access>;
-      group_access_allocator_type aal=al;
-      arrays.group_accesses=
-        boost::allocator_traits<group_access_allocator_type>::allocate(
-          aal,groups_size);
-      for(std::size_t n=0;n<groups_size;++n){
-        boost::allocator_traits<group_access_allocator_type>::construct(
-          aal,arrays.group_accesses+n);
-      }
-#endif
+    using group_access_allocator_type=
+      allocator_rebind_t<Allocator,group_access>;
+    group_access_allocator_type aal=al;
+    auto                        groups_size=arrays.groups_size_mask+1;
+    arrays.group_accesses=boost::to_address(
+      boost::allocator_traits<group_access_allocator_type>::allocate(
+        aal,groups_size));
+    for(std::size_t n=0;n<groups_size;++n){
+      boost::allocator_traits<group_access_allocator_type>::construct(
+        aal,arrays.group_accesses+n);
     }
-    return arrays;
+#else
+    (void)al;
+    (void)arrays;
+#endif
   }
 
   template<typename Allocator>
@@ -685,19 +1497,33 @@ struct table_arrays
       alloc_traits::deallocate(
         al,pointer_traits::pointer_to(*arrays.elements),
         buffer_size(arrays.groups_size_mask+1));
+      delete_group_accesses_(al,arrays);
+    }
+  }
 
+  template<typename Allocator>
+  static void delete_group_accesses_(
+    Allocator& al,table_arrays& arrays)noexcept
+  {
 #ifndef CFOA_EMBEDDED_GROUP_ACCESS
-      using group_access_allocator_type=
-        allocator_rebind_t<Allocator,group_access>;
-      group_access_allocator_type aal=al;
-      for(std::size_t n=0;n<arrays.groups_size_mask+1;++n){
-        boost::allocator_traits<group_access_allocator_type>::destroy(
-          aal,arrays.group_accesses+n);
-      }
-      boost::allocator_traits<group_access_allocator_type>::deallocate(
-        aal,arrays.group_accesses,arrays.groups_size_mask+1);
+    using group_access_allocator_type=
+      allocator_rebind_t<Allocator,group_access>;
+    using group_access_pointer=typename boost::allocator_traits<
+      group_access_allocator_type>::pointer;
+    group_access_allocator_type aal=al;
+    for(std::size_t n=0;n<arrays.groups_size_mask+1;++n){
+      boost::allocator_traits<group_access_allocator_type>::destroy(
+        aal,arrays.group_accesses+n);
+    }
+    boost::allocator_traits<group_access_allocator_type>::deallocate(
+      aal,
+      boost::pointer_traits<group_access_pointer>::pointer_to(
+        *arrays.group_accesses),
+      arrays.groups_size_mask+1);
+#else
+    (void)al;
+    (void)arrays;
 #endif
-    }
   }
 
   /* Combined space for elements and groups measured in
@@ -716,13 +1542,13 @@ struct table_arrays
     return (buffer_bytes+sizeof(element_type)-1)/sizeof(element_type);
   }
 
-  std::size_t   groups_size_index;
-  std::size_t   groups_size_mask;
-  group_type   *groups;
-  element_type *elements;
+  std::size_t                                 groups_size_index;
+  std::size_t                                 groups_size_mask;
+  arrays_pointer_t<group_type,VoidPointer>    groups;
+  arrays_pointer_t<element_type,VoidPointer>  elements;
 
 #ifndef CFOA_EMBEDDED_GROUP_ACCESS
-  group_access *group_accesses;
+  arrays_pointer_t<group_access,VoidPointer>  group_accesses;
 #endif
 };
 
@@ -797,6 +1623,22 @@ public:
   static constexpr bool value=decltype(check<Allocator>(0))::value;
 };
 
+template<typename Allocator,typename Ptr>
+struct alloc_has_destroy
+{
+private:
+  template<typename Allocator2>
+  static decltype(
+    std::declval<Allocator2&>().destroy(std::declval<Ptr>()),
+    std::true_type{}
+  ) check(int);
+
+  template<typename> static std::false_type check(...);
+
+public:
+  static constexpr bool value=decltype(check<Allocator>(0))::value;
+};
+
 template<typename T>
 void swap_atomic(std::atomic<T>& x,std::atomic<T>& y)
 {
@@ -894,15 +1736,129 @@ _STL_RESTORE_DEPRECATED_WARNING
  *   - TypePolicy::extract returns a const reference to the key part of a const
  *     reference to value_type, init_type, element_type or
  *     decltype(TypePolicy::move(...)).
+ *   - Optionally, TypePolicy::stored_hash(const element_type&) and
+ *     TypePolicy::store_hash(element_type&,std::size_t) give access to a
+ *     hash value kept within the element (see stored_hash_type_policy), which
+ *     is then used instead of rehashing the key on rehash, and checked before
+ *     comparing keys on lookup.
+ *   - Optionally, TypePolicy::atomically_updatable, if std::true_type,
+ *     declares that every modification of value_type possible through a
+ *     non-const reference is atomic (e.g. the mapped type is a std::atomic),
+ *     so that visit, try_emplace_or_visit and visit_all only need to
+ *     shared-lock groups.
  * 
  *  try_emplace, erase and find support heterogenous lookup by default, that
  *  is, without checking for any ::is_transparent typedefs --the checking is
  *  done by boost::unordered_[flat|node]_[map|set].
  * 
- *  At the moment, we're not supporting allocators with fancy pointers.
- *  Allocator::pointer must be convertible to/from regular pointers.
+ *  Allocators with fancy pointers are supported as far as the table's own
+ *  arrays are concerned (see table_arrays), which allows for tables living in
+ *  shared memory and used from several processes, provided that Mutex works
+ *  across processes (rw_spinlock does, std::shared_mutex doesn't) and that
+ *  elements themselves are meaningful in all of them. Iterators and
+ *  references to elements are raw pointers local to the process. Note that
+ *  the table object is overaligned and must be allocated accordingly.
+ */
+
+/* stored_hash_type_policy<TypePolicy> adapts TypePolicy so that each element
+ * also holds the (mixed) hash value of its key, as set by the table on
+ * insertion. For keys whose comparison or hashing involves out-of-line data
+ * (e.g. strings), rehashing then touches no key memory, and most false
+ * reduced hash matches on lookup are rejected without dereferencing the key,
+ * at the cost of a std::size_t per element.
  */
 
+template<typename TypePolicy>
+struct stored_hash_type_policy
+{
+  using key_type=typename TypePolicy::key_type;
+  using init_type=typename TypePolicy::init_type;
+  using value_type=typename TypePolicy::value_type;
+
+  struct element_type
+  {
+    typename TypePolicy::element_type e;
+    std::size_t                       hash;
+  };
+
+  static value_type& value_from(element_type& x)
+  {
+    return TypePolicy::value_from(x.e);
+  }
+
+  template<typename T>
+  static auto extract(const T& x)->decltype(TypePolicy::extract(x))
+  {
+    return TypePolicy::extract(x);
+  }
+
+  static auto extract(const element_type& x)
+    ->decltype(TypePolicy::extract(x.e))
+  {
+    return TypePolicy::extract(x.e);
+  }
+
+  static auto move(element_type& x)->decltype(TypePolicy::move(x.e))
+  {
+    return TypePolicy::move(x.e);
+  }
+
+  template<typename Allocator,typename... Args>
+  static void construct(Allocator& al,element_type* p,Args&&... args)
+  {
+    TypePolicy::construct(al,std::addressof(p->e),std::forward<Args>(args)...);
+  }
+
+  template<typename Allocator>
+  static void construct(Allocator& al,element_type* p,const element_type& x)
+  {
+    TypePolicy::construct(al,std::addressof(p->e),x.e);
+    p->hash=x.hash;
+  }
+
+  template<typename Allocator>
+  static void construct(Allocator& al,element_type* p,element_type& x)
+  {
+    construct(al,p,const_cast<const element_type&>(x));
+  }
+
+  template<typename Allocator>
+  static void destroy(Allocator& al,element_type* p)noexcept
+  {
+    TypePolicy::destroy(al,std::addressof(p->e));
+  }
+
+  static std::size_t stored_hash(const element_type& x){return x.hash;}
+
+  static void store_hash(element_type& x,std::size_t hash){x.hash=hash;}
+};
+
+template<typename TypePolicy,typename=void>
+struct has_stored_hash:std::false_type{};
+
+template<typename TypePolicy>
+struct has_stored_hash<
+  TypePolicy,
+  std::void_t<decltype(TypePolicy::stored_hash(
+    std::declval<const typename TypePolicy::element_type&>()))>
+>:std::true_type{};
+
+template<typename TypePolicy,typename=void>
+struct has_atomically_updatable_values:std::false_type{};
+
+template<typename TypePolicy>
+struct has_atomically_updatable_values<
+  TypePolicy,std::void_t<typename TypePolicy::atomically_updatable>
+>:TypePolicy::atomically_updatable{};
+
+template<typename Group,typename=void>
+struct has_slot_claim:std::false_type{};
+
+template<typename Group>
+struct has_slot_claim<
+  Group,std::void_t<decltype(std::declval<Group&>().claim(std::size_t(0)))>
+>:std::true_type{};
+
 /* We pull this out so the tests don't have to rely on a magic constant or
  * instantiate the table class template as it can be quite gory.
  */
@@ -910,7 +1866,7 @@ constexpr static float const mlf = 0.875f;
 
 template<
   typename TypePolicy,typename Hash,typename Pred,typename Allocator,
-  typename Mutex=rw_spinlock
+  typename Mutex=rw_spinlock,typename Group=group15
 >
 class 
 
@@ -924,7 +1880,7 @@ table:empty_value<Hash,0>,empty_value<Pred,1>,empty_value<Allocator,2>
   using pred_base=empty_value<Pred,1>;
   using allocator_base=empty_value<Allocator,2>;
   using type_policy=TypePolicy;
-  using group_type=group15;
+  using group_type=Group;
   static constexpr auto N=group_type::N;
   using size_policy=pow2_size_policy;
   using prober=pow2_quadratic_prober;
@@ -979,26 +1935,38 @@ public:
     hash_base{empty_init,std::move(x.h())},
     pred_base{empty_init,std::move(x.pred())},
     allocator_base{empty_init,std::move(x.al())},
-    size_{x.size_},arrays(x.arrays),ml{x.ml}
+    size_{0},arrays(x.arrays),ml{x.ml.load()},old_arrays(x.old_arrays),
+    migrating_{x.migrating_.load()},min_lf{x.min_lf}
   {
-    x.size_=0;
+    migration.next=x.migration.next.load();
+    migration.done=x.migration.done.load();
+    size_=x.size();
+    x.set_size(0);
     x.arrays=x.new_arrays(0);
     x.ml=x.initial_max_load();
+    x.old_arrays={};
+    x.migrating_=false;
+#if defined(BOOST_UNORDERED_CFOA_HAS_MMAP)
+    image=std::move(x.image);
+#endif
   }
 
   table(const table& x,const Allocator& al_):
     table{std::size_t(std::ceil(float(x.size())/mlf)),x.h(),x.pred(),al_}
   {
+    min_lf=x.min_lf;
     copy_elements_from(x);
   }
 
   table(table&& x,const Allocator& al_):
     table{0,std::move(x.h()),std::move(x.pred()),al_}
   {
+    min_lf=x.min_lf;
     if(al()==x.al()){
-      swap_atomic(size_,x.size_);
+      swap_size(x);
       std::swap(arrays,x.arrays);
       swap_atomic(ml,x.ml);
+      swap_migration(x);
     }
     else{
       reserve(x.size());
@@ -1014,12 +1982,37 @@ public:
     }
   }
 
+#if defined(BOOST_UNORDERED_PARALLEL_ALGORITHMS)
+  /* Copy construction with the elements of x copied by the threads of the
+   * execution policy (see copy_elements_from). Exceptions thrown while
+   * copying elements call std::terminate.
+   */
+
+  template<
+    typename ExecutionPolicy,
+    typename std::enable_if<
+      std::is_execution_policy<
+        typename std::decay<ExecutionPolicy>::type>::value>::type* =nullptr
+  >
+  table(ExecutionPolicy&& policy,const table& x):
+    table{
+      std::size_t(std::ceil(float(x.size())/mlf)),x.h(),x.pred(),
+      alloc_traits::select_on_container_copy_construction(x.al())}
+  {
+    min_lf=x.min_lf;
+    copy_elements_from(std::forward<ExecutionPolicy>(policy),x);
+  }
+#endif
+
   ~table()noexcept
   {
-    for_all_elements([this](element_type* p){
-      destroy_element(p);
+    if_constexpr<!trivially_destructible_elements>([this]{
+      for_all_elements([this](element_type* p){
+        destroy_element(p);
+      });
     });
     delete_arrays(arrays);
+    delete_arrays(old_arrays);
   }
 
   table& operator=(const table& x)
@@ -1045,6 +2038,7 @@ public:
       using std::swap;
       swap(h(),tmp_h);
       swap(pred(),tmp_p);
+      min_lf=x.min_lf;
 
       if_constexpr<pocca>([&,this]{
         if(al()!=x.al())reserve(0);
@@ -1088,13 +2082,15 @@ public:
       clear();
       swap(h(),x.h());
       swap(pred(),x.pred());
+      min_lf=x.min_lf;
 
       if(pocma||al()==x.al()){
         reserve(0);
         move_assign_if<pocma>(al(),x.al());
-        swap_atomic(size_,x.size_);
+        swap_size(x);
         swap(arrays,x.arrays);
         swap_atomic(ml,x.ml);
+        swap_migration(x);
       }
       else{
         /* noshrink: favor memory reuse over tightness */
@@ -1134,7 +2130,206 @@ public:
   const_iterator cend()const noexcept{return end();}
 
   bool        empty()const noexcept{return size()==0;}
-  std::size_t size()const noexcept{return size_;}
+
+  /* Element count is kept as a global size_ plus per-stripe deltas (see
+   * update_size). size() adds them up and is exact in the absence of
+   * concurrent modifications, e.g. under exclusive_access(); approximate_size()
+   * only reads size_ and is off by at most num_mutexes*(size_batch()-1).
+   */
+  std::size_t size()const noexcept
+  {
+    auto res=size_.load(std::memory_order_relaxed);
+    for(const auto& m:mutexes){
+      res+=std::size_t(m.size_delta.load(std::memory_order_relaxed));
+    }
+    return res;
+  }
+
+  std::size_t approximate_size()const noexcept
+  {
+    auto res=std::ptrdiff_t(size_.load(std::memory_order_relaxed));
+    return res<0?0:std::size_t(res);
+  }
+
+#if defined(BOOST_UNORDERED_CFOA_ENABLE_STATS)
+  /* merges per-stripe counters, exact in the absence of concurrent operations */
+
+  table_stats get_stats()const
+  {
+    table_stats res;
+    for(const auto& s:stats){
+      for(std::size_t i=0;i<stats_probe_length_buckets;++i){
+        res.lookup_probe_lengths[i]+=s.lookup_probe_lengths[i].load();
+        res.insertion_probe_lengths[i]+=s.insertion_probe_lengths[i].load();
+      }
+      res.false_matches+=s.false_matches.load();
+      res.startovers+=s.startovers.load();
+      res.overflow_bits_set+=s.overflow_bits_set.load();
+      res.rehashes+=s.rehashes.load();
+      res.rehash_time+=std::chrono::nanoseconds(s.rehash_time.load());
+    }
+    return res;
+  }
+
+  void reset_stats()noexcept
+  {
+    for(auto& s:stats){
+      for(std::size_t i=0;i<stats_probe_length_buckets;++i){
+        s.lookup_probe_lengths[i]=0;
+        s.insertion_probe_lengths[i]=0;
+      }
+      s.false_matches=0;
+      s.startovers=0;
+      s.overflow_bits_set=0;
+      s.rehashes=0;
+      s.rehash_time=0;
+    }
+  }
+#endif
+
+#if defined(BOOST_UNORDERED_CFOA_HAS_MMAP)
+  /* Binary image save/load, for element types copyable as raw bytes. Data
+   * referred to by elements out of line is dealt with by a Relocator r:
+   *   - r.save(e,arena,arena_address): e is a copy of an element about to be
+   *     written; r appends the data e refers to to arena (a std::string) and
+   *     makes e point into it as if arena were located at arena_address.
+   *   - r.relocate(e,from,to): makes e's pointers into the arena located at
+   *     address from point into the same arena located at address to.
+   * load_image replaces the table contents with the image, mapped privately
+   * (copy-on-write) and paged in lazily: no element is rehashed, and elements
+   * are only visited for relocation if the image doesn't get mapped at its
+   * preferred address. Images are only valid for tables with the same
+   * Hash, element and group types as the saving one.
+   */
+
+  template<typename Relocator>
+  void save_image(const char* filename,Relocator r)
+  {
+    static_assert(
+      image_supported,"element_type must be copyable as raw bytes");
+
+    auto lck=exclusive_access();
+    finish_migration();
+
+    std::size_t        groups_size=
+                         arrays.elements?arrays.groups_size_mask+1:0;
+    table_image_header hdr={};
+    std::memcpy(hdr.magic,table_image_magic,sizeof(hdr.magic));
+    hdr.element_size=sizeof(element_type);
+    hdr.group_size=sizeof(*arrays.groups);
+    hdr.groups_size_index=arrays.groups_size_index;
+    hdr.groups_size_mask=arrays.groups_size_mask;
+    hdr.size=size();
+    hdr.ml=ml;
+    hdr.elements_offset=table_image_align(sizeof(hdr));
+    hdr.groups_offset=table_image_align(
+      hdr.elements_offset+groups_size*N*sizeof(element_type));
+    hdr.arena_offset=table_image_align(
+      hdr.groups_offset+groups_size*sizeof(*arrays.groups));
+    hdr.base_address=table_image_base_address;
+
+    auto             arena_address=
+                       uintptr_t(hdr.base_address+hdr.arena_offset);
+    std::string      arena;
+    table_image_file f(filename);
+    for(std::size_t pos=0;pos<groups_size;++pos){
+      /* unoccupied slots are written as zeros */
+      alignas(element_type) unsigned char buf[N*sizeof(element_type)]={};
+      auto pg=arrays.groups+pos;
+      auto p=arrays.elements+pos*N;
+      auto mask=pg->match_occupied();
+      while(mask){
+        auto n=unchecked_countr_zero(mask);
+        auto pb=buf+n*sizeof(element_type);
+        std::memcpy(pb,p+n,sizeof(element_type));
+        r.save(
+          *std::launder(reinterpret_cast<element_type*>(pb)),
+          arena,arena_address);
+        mask&=mask-1;
+      }
+      f.write(
+        hdr.elements_offset+pos*sizeof(buf),buf,sizeof(buf));
+    }
+    f.write(
+      hdr.groups_offset,arrays.groups,groups_size*sizeof(*arrays.groups));
+    f.write(hdr.arena_offset,arena.data(),arena.size());
+    hdr.image_size=hdr.arena_offset+arena.size();
+    f.write(0,&hdr,sizeof(hdr));
+    f.close(hdr.image_size);
+  }
+
+  template<typename Relocator>
+  void load_image(const char* filename,Relocator r)
+  {
+    static_assert(
+      image_supported,"element_type must be copyable as raw bytes");
+
+    table_image_mapping img{filename};
+    auto&               hdr=img.header();
+    if(hdr.element_size!=sizeof(element_type)||
+       hdr.group_size!=sizeof(*arrays.groups)){
+      throw_table_image_error(EINVAL,filename);
+    }
+
+    /* the arrays are adopted as they are, so everything they're accessed
+     * through is validated first
+     */
+    bool            non_empty=hdr.groups_offset!=hdr.arena_offset;
+    boost::uint64_t groups_size=hdr.groups_size_mask+1;
+    if(non_empty){
+      constexpr boost::uint64_t bits=sizeof(std::size_t)*CHAR_BIT;
+      if(hdr.groups_size_mask>=SIZE_MAX/N||
+         (groups_size&hdr.groups_size_mask)!=0||
+         hdr.groups_size_index<1||hdr.groups_size_index>=bits||
+         size_policy::size(std::size_t(hdr.groups_size_index))!=
+           groups_size||
+         !table_image_fits(
+           hdr.elements_offset,groups_size*N,sizeof(element_type),
+           hdr.groups_offset)||
+         !table_image_fits(
+           hdr.groups_offset,groups_size,sizeof(*arrays.groups),
+           hdr.arena_offset)||
+         hdr.size>groups_size*N-1||hdr.ml>groups_size*N-1){
+        throw_table_image_error(EINVAL,filename);
+      }
+    }
+    else if(hdr.size!=0||hdr.ml!=0){
+      throw_table_image_error(EINVAL,filename);
+    }
+
+    arrays_type new_arrays_=new_arrays(0);
+    if(non_empty){
+      new_arrays_.groups_size_index=std::size_t(hdr.groups_size_index);
+      new_arrays_.groups_size_mask=std::size_t(hdr.groups_size_mask);
+      new_arrays_.elements=reinterpret_cast<element_type*>(
+        img.data()+hdr.elements_offset);
+      new_arrays_.groups=reinterpret_cast<typename arrays_type::group_type*>(
+        img.data()+hdr.groups_offset);
+      element_allocator_type eal=al();
+      arrays_type::new_group_accesses_(eal,new_arrays_);
+
+      auto from=uintptr_t(hdr.base_address+hdr.arena_offset),
+           to=reinterpret_cast<uintptr_t>(img.data()+hdr.arena_offset);
+      if(from!=to){
+        for_all_elements(new_arrays_,[&](element_type* p){
+          r.relocate(*p,from,to);
+        });
+      }
+    }
+
+    auto lck=exclusive_access();
+    finish_migration();
+    for_all_elements([this](element_type* p){
+      destroy_element(p);
+    });
+    delete_arrays(arrays);
+    arrays=new_arrays_;
+    image=std::move(img);
+    set_size(std::size_t(image.header().size));
+    ml=std::size_t(image.header().ml);
+  }
+#endif
+
   std::size_t max_size()const noexcept{return SIZE_MAX;}
 
   template<typename... Args>
@@ -1150,20 +2345,85 @@ public:
     return emplace_impl(emplace_type(std::forward<Args>(args)...));
   }
 
+  /* try_emplace_or_visit invokes f(x,false) on the element x with key
+   * equivalent to k if it exists and f(x,true) on the newly inserted element
+   * otherwise. Either way, the group holding x is exclusive-locked while f
+   * runs, so that f can safely modify x, except that an existing x is only
+   * shared-locked if values are atomically updatable (see group_visit).
+   * try_emplace_or_cvisit only shared-locks the group of an existing element
+   * and passes f a const reference. try_emplace is try_emplace_or_visit.
+   */
+
   template<typename F,typename Key,typename... Args>
   BOOST_FORCEINLINE void try_emplace(F f,Key&& x,Args&&... args)
   {
-    for(;;){
+    try_emplace_or_visit(f,std::forward<Key>(x),std::forward<Args>(args)...);
+  }
+
+  template<typename F,typename Key,typename... Args>
+  BOOST_FORCEINLINE void try_emplace_or_visit(F f,Key&& x,Args&&... args)
+  {
+    try_emplace_impl(
+      group_visit{},f,std::forward<Key>(x),std::forward<Args>(args)...);
+  }
+
+  template<typename F,typename Key,typename... Args>
+  BOOST_FORCEINLINE void try_emplace_or_cvisit(F f,Key&& x,Args&&... args)
+  {
+    auto cf=[&](const value_type& v,bool inserted){f(v,inserted);};
+    try_emplace_impl(
+      group_shared{},cf,std::forward<Key>(x),std::forward<Args>(args)...);
+  }
+
+  /* Bulk counterpart of try_emplace: each key k in [first,last) is
+   * try_emplace'd as if by try_emplace(f,k,args...). Keys are processed in
+   * batches of bulk_insert_size whose hash values are calculated and groups
+   * prefetched ahead of insertion. The table-level shared lock is taken (and
+   * incremental migration advanced) once per batch rather than once per key,
+   * and released between batches so that long ranges don't hold back
+   * migration, growth or other exclusive operations.
+   */
+
+  static constexpr std::size_t bulk_insert_size=16;
+
+  template<typename F,typename FwdIterator,typename... Args>
+  void try_emplace_bulk(
+    F f,FwdIterator first,FwdIterator last,const Args&... args)
+  {
+    std::size_t hashes[bulk_insert_size];
+    std::size_t m=0,i=0; /* current batch size and position */
+
+    while(first!=last){
       std::size_t n;
+      bool        migrated,res=true;
       {
         auto lck=shared_access();
+        migrated=migrate_some();
         n=capacity();
-        if(emplace_impl(
-          f,try_emplace_args_t{},std::forward<Key>(x),std::forward<Args>(args)...))return;
-      }
+        if(i==m){
+          m=i=0;
+          for(auto it=first;m<bulk_insert_size&&it!=last;++it,++m){
+            hashes[m]=hash_for(*it);
+            auto pos=position_for(hashes[m]);
+            prefetch(arrays.groups+pos);
+            prefetch_elements(arrays.elements+pos*N);
+          }
+        }
 
-      auto lck=exclusive_access();
-      if(capacity()<=n)rehash(n+1);
+        /* on reaching max load, the rest of the batch is resumed after
+         * growing
+         */
+        for(;i<m;++i,++first){
+          res=emplace_with_hash(
+            group_visit{},f,hashes[i],try_emplace_args_t{},*first,args...);
+          if(BOOST_UNLIKELY(!res))break;
+        }
+      }
+      if(BOOST_UNLIKELY(migrated))release_old_arrays();
+      if(BOOST_UNLIKELY(!res)){
+        auto lck=exclusive_access();
+        if(capacity()<=n)unchecked_start_migration(n+1);
+      }
     }
   }
 
@@ -1197,18 +2457,32 @@ public:
     recover_slot(pos.pc);
   }
 
+  /* erase(x) and erase_if(x,pr) can be executed concurrently with
+   * try_emplace and find: the table is shared-locked and the group containing
+   * the element exclusive-locked for the duration of element destruction and
+   * slot recovery.
+   */
+
   template<typename Key>
   BOOST_FORCEINLINE
   auto erase(Key&& x) -> typename std::enable_if<
     !std::is_convertible<Key,iterator>::value&&
     !std::is_convertible<Key,const_iterator>::value, std::size_t>::type
   {
-    auto it=find(x);
-    if(it!=end()){
-      erase(it);
-      return 1;
+    return erase_if(x,[](const value_type&){return true;});
+  }
+
+  template<typename Key,typename Predicate>
+  BOOST_FORCEINLINE std::size_t erase_if(const Key& x,Predicate pr)
+  {
+    std::size_t res;
+    {
+      auto lck=shared_access();
+      auto hash=hash_for(x);
+      res=erase_impl(x,pr,hash);
     }
-    else return 0;
+    if(BOOST_UNLIKELY(res&&below_min_load()))shrink_on_erasure();
+    return res;
   }
 
   void swap(table& x)
@@ -1232,34 +2506,62 @@ public:
 
     swap(h(),x.h());
     swap(pred(),x.pred());
-    swap_atomic(size_,x.size_);
+    swap(min_lf,x.min_lf);
+    swap_size(x);
     swap(arrays,x.arrays);
     swap_atomic(ml,x.ml);
+    swap_migration(x);
   }
 
   void clear()noexcept
   {
-    auto p=arrays.elements;
-    if(p){
-      for(auto pg=arrays.groups,last=pg+arrays.groups_size_mask+1;
-          pg!=last;++pg,p+=N){
-        auto mask=pg->match_really_occupied();
-        while(mask){
-          destroy_element(p+unchecked_countr_zero(mask));
-          mask&=mask-1;
-        }
-        /* we wipe the entire metadata to reset the overflow byte as well */
-        pg->initialize();
-      }
-      arrays.groups[arrays.groups_size_mask].set_sentinel();
-      size_=0;
+    /* elements not yet migrated are destroyed in place, as in clear(policy) */
+    if(old_arrays.elements){
+      clear_elements(old_arrays);
+      migrating_=false;
+      delete_arrays(old_arrays);
+      old_arrays={};
+    }
+    if(arrays.elements){
+      clear_elements(arrays);
+      set_size(0);
+      ml=initial_max_load();
+    }
+  }
+
+#if defined(BOOST_UNORDERED_PARALLEL_ALGORITHMS)
+  /* Parallel clear: groups are distributed among the threads of the
+   * execution policy, which destroy their elements and reset their metadata.
+   * Trivially destructible elements are not visited at all, and the pages
+   * holding them are given back to the OS where supported (they're
+   * transparently zero-filled on next use). As ~table only destroys elements
+   * still in the table, clear(policy) right before destruction makes for a
+   * parallel teardown. Not to be run concurrently with other operations.
+   */
+
+  template<typename ExecutionPolicy>
+  auto clear(ExecutionPolicy&& policy)noexcept
+    ->typename std::enable_if<
+      std::is_execution_policy<
+        typename std::decay<ExecutionPolicy>::type>::value>::type
+  {
+    if(old_arrays.elements){
+      clear_elements(policy,old_arrays);
+      migrating_=false;
+      delete_arrays(old_arrays);
+      old_arrays={};
+    }
+    if(arrays.elements){
+      clear_elements(std::forward<ExecutionPolicy>(policy),arrays);
+      set_size(0);
       ml=initial_max_load();
     }
   }
+#endif
 
   // TODO: should we accept different allocator too?
   template<typename Hash2,typename Pred2>
-  void merge(table<TypePolicy,Hash2,Pred2,Allocator>& x)
+  void merge(table<TypePolicy,Hash2,Pred2,Allocator,Mutex,Group>& x)
   {
     x.for_all_elements([&,this](group_type* pg,unsigned int n,element_type* p){
       if(emplace_impl(type_policy::move(*p)).second){
@@ -1269,25 +2571,122 @@ public:
   }
 
   template<typename Hash2,typename Pred2>
-  void merge(table<TypePolicy,Hash2,Pred2,Allocator>&& x){merge(x);}
+  void merge(table<TypePolicy,Hash2,Pred2,Allocator,Mutex,Group>&& x){merge(x);}
 
   hasher hash_function()const{return h();}
   key_equal key_eq()const{return pred();}
 
+  /* visit invokes f on the element with key equivalent to x, if any, with
+   * its group exclusive-locked so that f can modify the element (or
+   * shared-locked for atomically updatable values, see group_visit). cvisit
+   * passes f a const reference and doesn't lock groups when value_type can
+   * be snapshotted (see optimistic_find_impl), f being then invoked on a copy
+   * of the element; otherwise, the group is shared-locked. Non-const find is
+   * visit and const find is cvisit.
+   */
+
+  template<typename Key,typename F>
+  BOOST_FORCEINLINE bool visit(const Key& x,F f)
+  {
+    bool migrated,res;
+    {
+      auto lck=shared_access();
+      migrated=migrate_some();
+      auto hash=hash_for(x);
+      res=find_impl(group_visit{},x,f,hash);
+    }
+    if(BOOST_UNLIKELY(migrated))release_old_arrays();
+    return res;
+  }
+
   template<typename Key,typename F>
-  BOOST_FORCEINLINE bool find(const Key& x,F f)
+  BOOST_FORCEINLINE bool cvisit(const Key& x,F f)const
   {
-    auto lck=shared_access();
-    auto hash=hash_for(x);
-    return find_impl(x,f,position_for(hash),hash);
+    return const_cast<table*>(this)->cfind(x,f,optimistic_group_access{});
   }
 
   template<typename Key,typename F>
-  BOOST_FORCEINLINE bool find(const Key& x,F f)const
+  BOOST_FORCEINLINE bool find(const Key& x,F f){return visit(x,f);}
+
+  template<typename Key,typename F>
+  BOOST_FORCEINLINE bool find(const Key& x,F f)const{return cvisit(x,f);}
+
+  /* Bulk lookup: keys in [first,last) are processed in batches of
+   * bulk_lookup_size; for each batch, hash values are calculated and the
+   * corresponding groups and element slots prefetched before any of the keys
+   * is looked up, so that memory latencies of lookups in the same batch
+   * overlap. f is invoked for each element found, as in find. Returns the
+   * number of elements found. The table-level lock is taken once per batch,
+   * so that long ranges don't hold back growth and other exclusive
+   * operations.
+   */
+
+  static constexpr std::size_t bulk_lookup_size=16;
+
+  template<typename FwdIterator,typename F>
+  BOOST_FORCEINLINE std::size_t find_bulk(
+    FwdIterator first,FwdIterator last,F f)
   {
-    return const_cast<table*>(this)->find(x,f);
+    return bulk_find(first,last,f,group_visit{});
   }
 
+  template<typename FwdIterator,typename F>
+  BOOST_FORCEINLINE std::size_t find_bulk(
+    FwdIterator first,FwdIterator last,F f)const
+  {
+    return const_cast<table*>(this)->bulk_find(
+      first,last,[&](const value_type& v){f(v);},optimistic_group_access{});
+  }
+
+  /* visit_all invokes f on every element of the table, with the table-level
+   * shared lock held for the duration of the traversal and each group
+   * exclusive-locked (as in visit) while its elements are being visited, so
+   * it can run concurrently with other operations. cvisit_all passes f a
+   * const reference and only shared-locks groups. An ongoing incremental
+   * rehash is completed first so that no element is missed or visited twice.
+   * The overloads taking an execution policy distribute groups among threads
+   * with std::for_each; f is then invoked concurrently and must be safe to do
+   * so. All overloads return the number of elements visited.
+   */
+
+  template<typename F>
+  std::size_t visit_all(F f)
+  {
+    return visit_all_impl(group_visit{},f);
+  }
+
+  template<typename F>
+  std::size_t cvisit_all(F f)const
+  {
+    auto cf=[&](const value_type& v){f(v);};
+    return const_cast<table*>(this)->visit_all_impl(group_shared{},cf);
+  }
+
+#if defined(BOOST_UNORDERED_PARALLEL_ALGORITHMS)
+  template<typename ExecutionPolicy,typename F>
+  auto visit_all(ExecutionPolicy&& policy,F f)
+    ->typename std::enable_if<
+      std::is_execution_policy<
+        typename std::decay<ExecutionPolicy>::type>::value,
+      std::size_t>::type
+  {
+    return visit_all_impl(
+      group_visit{},std::forward<ExecutionPolicy>(policy),f);
+  }
+
+  template<typename ExecutionPolicy,typename F>
+  auto cvisit_all(ExecutionPolicy&& policy,F f)const
+    ->typename std::enable_if<
+      std::is_execution_policy<
+        typename std::decay<ExecutionPolicy>::type>::value,
+      std::size_t>::type
+  {
+    auto cf=[&](const value_type& v){f(v);};
+    return const_cast<table*>(this)->visit_all_impl(
+      group_shared{},std::forward<ExecutionPolicy>(policy),cf);
+  }
+#endif
+
   std::size_t capacity()const noexcept
   {
     return arrays.elements?(arrays.groups_size_mask+1)*N-1:0;
@@ -1301,10 +2700,27 @@ public:
 
   float max_load_factor()const noexcept{return mlf;}
 
+  /* When set to a nonzero value, erasures bringing the load factor below
+   * min_load_factor() shrink the table as shrink_to_fit() does, but to
+   * arrays sized for a load factor of max_load_factor()/2, so that the table
+   * has to double its size before growing again. The value is capped at
+   * max_load_factor()/4, so the table also has to halve its size before
+   * shrinking again. Not to be set concurrently with other operations.
+   */
+
+  float min_load_factor()const noexcept{return min_lf;}
+
+  void min_load_factor(float x)noexcept
+  {
+    min_lf=(std::min)((std::max)(x,0.0f),mlf/4);
+  }
+
   std::size_t max_load()const noexcept{return ml;}
 
   void rehash(std::size_t n)
   {
+    finish_migration();
+
     auto m=size_t(std::ceil(float(size())/mlf));
     if(m>n)n=m;
     if(n)n=capacity_for(n); /* exact resulting capacity */
@@ -1317,6 +2733,59 @@ public:
     rehash(std::size_t(std::ceil(float(n)/mlf)));
   }
 
+  /* Unlike rehash, shrink_to_fit can run concurrently with other operations.
+   * If the table can be held in smaller arrays, the world is stopped only to
+   * allocate them and elements are moved by incremental migration, as when
+   * the table grows (see migrate_some), with the calling thread helping
+   * complete it. Once migrated, the old arrays are deallocated. Nothing
+   * happens if a migration is already in progress.
+   */
+
+  void shrink_to_fit(){shrink(mlf);}
+
+#if defined(BOOST_UNORDERED_PARALLEL_ALGORITHMS)
+  /* Parallel rehash: rather than being transferred by the calling thread,
+   * elements are migrated as in an incremental rehash (see migrate_some) by
+   * the threads of the execution policy, each taking whole old groups and
+   * inserting into the new arrays under their destination group locks. As
+   * with rehash(n), no other operation can run concurrently. Exceptions
+   * thrown while transferring elements call std::terminate, as with any
+   * parallel algorithm.
+   */
+
+  template<typename ExecutionPolicy>
+  auto rehash(ExecutionPolicy&& policy,std::size_t n)
+    ->typename std::enable_if<
+      std::is_execution_policy<
+        typename std::decay<ExecutionPolicy>::type>::value>::type
+  {
+    finish_migration(policy);
+
+    auto m=size_t(std::ceil(float(size())/mlf));
+    if(m>n)n=m;
+    if(n)n=capacity_for(n); /* exact resulting capacity */
+
+    if(n==capacity())return;
+    if(!n||!arrays.elements){
+      unchecked_rehash(n);
+      return;
+    }
+    unchecked_start_migration(n);
+    finish_migration(std::forward<ExecutionPolicy>(policy));
+  }
+
+  template<typename ExecutionPolicy>
+  auto reserve(ExecutionPolicy&& policy,std::size_t n)
+    ->typename std::enable_if<
+      std::is_execution_policy<
+        typename std::decay<ExecutionPolicy>::type>::value>::type
+  {
+    rehash(
+      std::forward<ExecutionPolicy>(policy),
+      std::size_t(std::ceil(float(n)/mlf)));
+  }
+#endif
+
   template<typename Predicate>
   friend std::size_t erase_if(table& x,Predicate pr)
   {
@@ -1324,10 +2793,12 @@ public:
   }
 
 private:
-  template<typename,typename,typename,typename,typename> friend class table;
+  template<typename,typename,typename,typename,typename,typename>
+  friend class table;
   using element_type=typename type_policy::element_type;
   using element_allocator_type=allocator_rebind_t<Allocator,element_type>;
-  using arrays_type=table_arrays<element_type,group_type,size_policy>;
+  using arrays_type=table_arrays<
+    element_type,group_type,size_policy,typename alloc_traits::void_pointer>;
 
   struct clear_on_exit
   {
@@ -1343,37 +2814,99 @@ private:
   const Allocator& al()const{return allocator_base::get();}
 
 
-#ifdef CFOA_EMBEDDED_GROUP_ACCESS
-  inline auto shared_access(std::size_t pos)const
+#ifdef CFOA_EMBEDDED_GROUP_ACCESS
+  static inline auto shared_access(const arrays_type& arrays_,std::size_t pos)
+  {
+    return arrays_.groups[pos].shared_access();
+  }
+
+  static inline auto exclusive_access(
+    const arrays_type& arrays_,std::size_t pos)
+  {
+    return arrays_.groups[pos].exclusive_access();
+  }
+
+  static inline auto& counter(const arrays_type& arrays_,std::size_t pos)
+  {
+    return arrays_.groups[pos].counter();
+  }
+
+  static inline auto& version(const arrays_type& arrays_,std::size_t pos)
+  {
+    return arrays_.groups[pos].version();
+  }
+#else
+  static inline auto shared_access(const arrays_type& arrays_,std::size_t pos)
+  {
+    return arrays_.group_accesses[pos].shared_access();
+  }
+
+  static inline auto exclusive_access(
+    const arrays_type& arrays_,std::size_t pos)
+  {
+    return arrays_.group_accesses[pos].exclusive_access();
+  }
+
+  static inline auto& counter(const arrays_type& arrays_,std::size_t pos)
+  {
+    return arrays_.group_accesses[pos].counter();
+  }
+
+  static inline auto& version(const arrays_type& arrays_,std::size_t pos)
   {
-    return arrays.groups[pos].shared_access();
+    return arrays_.group_accesses[pos].version();
   }
+#endif
 
-  inline auto exclusive_access(std::size_t pos)const
+  /* Group access modes of element visitation: with group_exclusive, the
+   * group is exclusive-locked and the visitation function can modify the
+   * element; with group_shared, the group is shared-locked and the function
+   * must only inspect it; with group_optimistic, no group lock is taken (see
+   * optimistic_find_impl).
+   */
+
+  struct group_shared{};
+  struct group_exclusive{};
+  struct group_optimistic{};
+
+  /* Mutable visitation can do with group_shared when values are atomically
+   * updatable: concurrent updates of the same element are then race-free
+   * and don't block readers of the group. Insertion still exclusive-locks
+   * the group to construct the new element.
+   */
+
+  static constexpr bool atomic_visitation=
+    has_atomically_updatable_values<type_policy>::value;
+
+  using group_visit=typename std::conditional<
+    atomic_visitation,group_shared,group_exclusive>::type;
+
+  static inline auto access(
+    group_shared,const arrays_type& arrays_,std::size_t pos)
   {
-    return arrays.groups[pos].exclusive_access();
+    return shared_access(arrays_,pos);
   }
 
-  inline auto& counter(std::size_t pos)const
+  static inline auto access(
+    group_exclusive,const arrays_type& arrays_,std::size_t pos)
   {
-    return arrays.groups[pos].counter();
+    return exclusive_access(arrays_,pos);
   }
-#else
+
   inline auto shared_access(std::size_t pos)const
   {
-    return arrays.group_accesses[pos].shared_access();
+    return shared_access(arrays,pos);
   }
 
   inline auto exclusive_access(std::size_t pos)const
   {
-    return arrays.group_accesses[pos].exclusive_access();
+    return exclusive_access(arrays,pos);
   }
 
   inline auto& counter(std::size_t pos)const
   {
-    return arrays.group_accesses[pos].counter();
+    return counter(arrays,pos);
   }
-#endif
 
   arrays_type new_arrays(std::size_t n)
   {
@@ -1384,6 +2917,13 @@ private:
   void delete_arrays(arrays_type& arrays_)noexcept
   {
     element_allocator_type eal=al();
+#if defined(BOOST_UNORDERED_CFOA_HAS_MMAP)
+    if(BOOST_UNLIKELY(arrays_.elements&&image.contains(arrays_.elements))){
+      /* the mapping stays as elements may still refer to its arena */
+      arrays_type::delete_group_accesses_(eal,arrays_);
+      return;
+    }
+#endif
     arrays_type::delete_(eal,arrays_);
   }
 
@@ -1436,11 +2976,28 @@ private:
     element_type *p;
   };
 
+  void clear_elements(arrays_type& arrays_)noexcept
+  {
+    auto p=boost::to_address(arrays_.elements);
+    for(auto pg=boost::to_address(arrays_.groups),
+             last=pg+arrays_.groups_size_mask+1;
+        pg!=last;++pg,p+=N){
+      auto mask=pg->match_occupied();
+      while(mask){
+        destroy_element(p+unchecked_countr_zero(mask));
+        mask&=mask-1;
+      }
+      /* we wipe the entire metadata to reset the overflow byte as well */
+      pg->initialize();
+    }
+  }
+
   void copy_elements_from(const table& x)
   {
     BOOST_ASSERT(empty());
     BOOST_ASSERT(this!=std::addressof(x));
-    if(arrays.groups_size_mask==x.arrays.groups_size_mask){
+    if(arrays.groups_size_mask==x.arrays.groups_size_mask&&
+       !x.old_arrays.elements){
       fast_copy_elements_from(x);
     }
     else{
@@ -1450,35 +3007,164 @@ private:
     }
   }
 
+#if defined(BOOST_UNORDERED_PARALLEL_ALGORITHMS)
+  /* Groups of x are distributed among the threads of the execution policy.
+   * With equal capacities and no ongoing migration in x, each thread copies
+   * element slots and metadata of its groups verbatim, as
+   * fast_copy_elements_from does; otherwise elements are inserted
+   * concurrently as they are when migrating.
+   */
+
+  template<typename ExecutionPolicy>
+  void copy_elements_from(ExecutionPolicy&& policy,const table& x)
+  {
+    BOOST_ASSERT(empty());
+    BOOST_ASSERT(this!=std::addressof(x));
+    if(arrays.groups_size_mask==x.arrays.groups_size_mask&&
+       !x.old_arrays.elements){
+      if(!arrays.elements)return;
+      std::for_each(
+        std::forward<ExecutionPolicy>(policy),
+        x.arrays.groups,x.arrays.groups+x.arrays.groups_size_mask+1,
+        [&,this](const typename arrays_type::group_type& g){
+          auto pos=std::size_t(&g-x.arrays.groups);
+          copy_group_from(x,pos);
+          copy_group_metadata(x,pos);
+        });
+    }
+    else{
+      auto copy_all=[&,this](const arrays_type& arrays_){
+        if(!arrays_.elements)return;
+        std::for_each(
+          policy,
+          arrays_.groups,arrays_.groups+arrays_.groups_size_mask+1,
+          [&,this](const typename arrays_type::group_type& g){
+            auto p=arrays_.elements+(&g-arrays_.groups)*N;
+            auto mask=g.match_occupied();
+            while(mask){
+              const auto& e=p[unchecked_countr_zero(mask)];
+              auto  hash=hash_for_element(e);
+              nosize_concurrent_emplace_at(
+                arrays,position_for(hash),hash,e);
+              mask&=mask-1;
+            }
+          });
+      };
+      copy_all(x.old_arrays);
+      copy_all(x.arrays);
+    }
+    set_size(x.size());
+  }
+
+  void copy_group_from(const table& x,std::size_t pos)
+  {
+    auto p=arrays.elements+pos*N;
+    auto q=x.arrays.elements+pos*N;
+    if_constexpr<trivially_copyable_elements>([&]{
+      std::memcpy(
+        reinterpret_cast<unsigned char*>(p),
+        reinterpret_cast<const unsigned char*>(q),
+        N*sizeof(element_type));
+    },
+    [&,this]{ /* else */
+      auto mask=x.arrays.groups[pos].match_occupied();
+      while(mask){
+        auto n=unchecked_countr_zero(mask);
+        construct_element(p+n,const_cast<const element_type&>(q[n]));
+        mask&=mask-1;
+      }
+    });
+  }
+
+  template<typename ExecutionPolicy>
+  void clear_elements(ExecutionPolicy&& policy,arrays_type& arrays_)noexcept
+  {
+    auto first=boost::to_address(arrays_.elements);
+    std::for_each(
+      std::forward<ExecutionPolicy>(policy),
+      arrays_.groups,arrays_.groups+arrays_.groups_size_mask+1,
+      [&,this](typename arrays_type::group_type& g){
+        if_constexpr<!trivially_destructible_elements>([&,this]{
+          auto p=first+(&g-arrays_.groups)*N;
+          auto mask=g.match_occupied();
+          while(mask){
+            destroy_element(p+unchecked_countr_zero(mask));
+            mask&=mask-1;
+          }
+        });
+        g.initialize();
+      });
+    if_constexpr<trivially_destructible_elements>([&]{
+      release_pages(first,first+(arrays_.groups_size_mask+1)*N);
+    });
+  }
+
+  static void release_pages(element_type* first,element_type* last)noexcept
+  {
+#if defined(__linux__)
+    /* only whole pages within [first,last), whose contents we don't care
+     * about; failure (e.g. on hugetlbfs misalignment) is harmless
+     */
+    auto page=static_cast<std::uintptr_t>(::sysconf(_SC_PAGESIZE));
+    auto b=(reinterpret_cast<std::uintptr_t>(first)+page-1)&~(page-1),
+         e=reinterpret_cast<std::uintptr_t>(last)&~(page-1);
+    if(e>b)::madvise(reinterpret_cast<void*>(b),e-b,MADV_DONTNEED);
+#else
+    (void)first;
+    (void)last;
+#endif
+  }
+#endif
+
+  /* Copies the metadata of group pos from x, but not its lock, as
+   * arrays.groups are protected_groups whose locks mustn't be copied. Group
+   * holds nothing but lock-free atomics, which have the layout of their
+   * values, so a bitwise copy of the Group base is valid as long as there's
+   * no concurrent access to x; it goes through void* because atomics aren't
+   * trivially copyable.
+   */
+
+  void copy_group_metadata(const table& x,std::size_t pos)
+  {
+    std::memcpy(
+      static_cast<void*>(static_cast<group_type*>(arrays.groups+pos)),
+      static_cast<const void*>(
+        static_cast<const group_type*>(x.arrays.groups+pos)),
+      sizeof(group_type));
+  }
+
   void fast_copy_elements_from(const table& x)
   {
     if(arrays.elements){
       copy_elements_array_from(x);
-      std::memcpy(
-        arrays.groups,x.arrays.groups,
-        (arrays.groups_size_mask+1)*sizeof(group_type));
-      size_=x.size();
+      for(std::size_t pos=0;pos<=arrays.groups_size_mask;++pos){
+        copy_group_metadata(x,pos);
+      }
+      set_size(x.size());
     }
   }
 
-  void copy_elements_array_from(const table& x)
-  {
-    copy_elements_array_from(
-      x,
-      std::integral_constant<
-        bool,
-        std::is_same<element_type,value_type>::value&&
+  static constexpr bool trivially_copyable_elements=
+    std::is_same<element_type,value_type>::value&&
 #if BOOST_WORKAROUND(BOOST_LIBSTDCXX_VERSION,<50000)
-        /* std::is_trivially_copy_constructible not provided */
-        boost::has_trivial_copy<value_type>::value
+    /* std::is_trivially_copy_constructible not provided */
+    boost::has_trivial_copy<value_type>::value
 #else
-        std::is_trivially_copy_constructible<value_type>::value
+    std::is_trivially_copy_constructible<value_type>::value
 #endif
-        &&(
-          is_std_allocator<Allocator>::value||
-          !alloc_has_construct<Allocator,value_type*,const value_type&>::value)
-      >{}
-    );
+    &&(
+      is_std_allocator<Allocator>::value||
+      !alloc_has_construct<Allocator,value_type*,const value_type&>::value);
+
+  static constexpr bool trivially_destructible_elements=
+    std::is_trivially_destructible<element_type>::value&&(
+      is_std_allocator<Allocator>::value||
+      !alloc_has_destroy<Allocator,element_type*>::value);
+
+  void copy_elements_array_from(const table& x)
+  {
+    copy_elements_array_from(
+      x,std::integral_constant<bool,trivially_copyable_elements>{});
   }
 
   void copy_elements_array_from(const table& x,std::true_type /* -> memcpy */)
@@ -1488,8 +3174,8 @@ private:
      * constructibility.
      */
     std::memcpy(
-      reinterpret_cast<unsigned char*>(arrays.elements),
-      reinterpret_cast<unsigned char*>(x.arrays.elements),
+      reinterpret_cast<unsigned char*>(boost::to_address(arrays.elements)),
+      reinterpret_cast<unsigned char*>(boost::to_address(x.arrays.elements)),
       x.capacity()*sizeof(element_type));
   }
 
@@ -1514,6 +3200,95 @@ private:
     BOOST_CATCH_END
   }
 
+  /* Insertions and erasures accumulate into the size_delta of the calling
+   * thread's mutex stripe, which shares its cache line with the mutex already
+   * locked by shared_access(), and only fold into the global size_ once the
+   * delta reaches size_batch() in absolute value. This removes size_ as a
+   * write hot spot while keeping its error bounded for growth decisions.
+   */
+  void update_size(std::ptrdiff_t d)
+  {
+    auto& m=mutexes[stripe_index()];
+    auto  n=m.size_delta.fetch_add(d,std::memory_order_relaxed)+d;
+    auto  batch=size_batch();
+    if(BOOST_UNLIKELY(n>=batch||n<=-batch)){
+      size_.fetch_add(
+        std::size_t(m.size_delta.exchange(0,std::memory_order_relaxed)),
+        std::memory_order_relaxed);
+    }
+  }
+
+  /* The accumulated error num_mutexes*(batch-1) is kept within half the slack
+   * between capacity and maximum load, so that decisions based on size_ can't
+   * let the table fill up. Small tables get batch==1, i.e. exact counting.
+   */
+  static constexpr std::size_t max_size_batch=64;
+
+  std::ptrdiff_t size_batch()const
+  {
+    auto slack=capacity()-ml.load(std::memory_order_relaxed);
+    return std::ptrdiff_t((std::min)(
+      max_size_batch,(std::max)(std::size_t(1),slack/(2*num_mutexes))));
+  }
+
+  bool below_max_load()const
+  {
+    /* signed as pending erasures may have made size_ transiently "negative" */
+    return std::ptrdiff_t(size_.load(std::memory_order_relaxed))<
+           std::ptrdiff_t(ml.load(std::memory_order_relaxed));
+  }
+
+  bool below_min_load()const
+  {
+    /* checked after erasure, hence approximate_size() for speed */
+    if(BOOST_LIKELY(min_lf==0.0f)||migrating())return false;
+    auto size=approximate_size();
+    auto capacity_=capacity();
+    return float(size)<min_lf*float(capacity_)&&
+           capacity_for(std::size_t(std::ceil(float(size)/(mlf/2))))<
+             capacity_;
+  }
+
+  /* automatic shrinking after erasure (see min_load_factor) */
+
+  void shrink_on_erasure(){shrink(mlf/2);}
+
+  /* moves the elements to the smallest arrays holding size() elements at
+   * load factor lf, if smaller than the current ones (see shrink_to_fit)
+   */
+
+  void shrink(float lf)
+  {
+    if(migrating())return;
+    {
+      auto lck=exclusive_access();
+      if(migrating()||!arrays.elements)return;
+      auto n=capacity_for(std::size_t(std::ceil(float(size())/lf)));
+      if(n>=capacity())return;
+      unchecked_start_migration(n);
+    }
+
+    bool migrated;
+    {
+      auto lck=shared_access();
+      migrated=complete_migration();
+    }
+    if(migrated)release_old_arrays();
+  }
+
+  void set_size(std::size_t n)
+  {
+    for(auto& m:mutexes)m.size_delta.store(0,std::memory_order_relaxed);
+    size_.store(n,std::memory_order_relaxed);
+  }
+
+  void swap_size(table& x)
+  {
+    auto n=size();
+    set_size(x.size());
+    x.set_size(n);
+  }
+
   void recover_slot(unsigned char* pc)
   {
     /* If this slot potentially caused overflow, we decrease the maximum load so
@@ -1522,7 +3297,7 @@ private:
      */
     ml-=group_type::maybe_caused_overflow(pc);
     group_type::reset(pc);
-    --size_;
+    update_size(-1);
   }
 
   void recover_slot(group_type* pg,std::size_t pos)
@@ -1563,6 +3338,62 @@ private:
     return mix_policy::mix(h(),x);
   }
 
+  /* Stored hash support (see stored_hash_type_policy) */
+
+  static constexpr bool stores_hash=has_stored_hash<type_policy>::value;
+  using stores_hash_type=std::integral_constant<bool,stores_hash>;
+
+  inline std::size_t hash_for_element(const element_type& x)const
+  {
+    return hash_for_element(x,stores_hash_type{});
+  }
+
+  inline std::size_t hash_for_element(
+    const element_type& x,std::true_type)const
+  {
+    return type_policy::stored_hash(x);
+  }
+
+  inline std::size_t hash_for_element(
+    const element_type& x,std::false_type)const
+  {
+    return hash_for(key_from(x));
+  }
+
+  static inline void store_hash(element_type* p,std::size_t hash)
+  {
+    store_hash(p,hash,stores_hash_type{});
+  }
+
+  static inline void store_hash(
+    element_type* p,std::size_t hash,std::true_type)
+  {
+    type_policy::store_hash(*p,hash);
+  }
+
+  static inline void store_hash(element_type*,std::size_t,std::false_type){}
+
+  template<typename Key>
+  BOOST_FORCEINLINE bool element_matches(
+    const Key& x,std::size_t hash,const element_type& e)const
+  {
+    return element_matches(x,hash,e,stores_hash_type{});
+  }
+
+  template<typename Key>
+  BOOST_FORCEINLINE bool element_matches(
+    const Key& x,std::size_t hash,const element_type& e,std::true_type)const
+  {
+    return type_policy::stored_hash(e)==hash&&bool(pred()(x,key_from(e)));
+  }
+
+  template<typename Key>
+  BOOST_FORCEINLINE bool element_matches(
+    const Key& x,std::size_t,const element_type& e,std::false_type)const
+  {
+    return bool(pred()(x,key_from(e)));
+  }
+
   inline std::size_t position_for(std::size_t hash)const
   {
     return position_for(hash,arrays);
@@ -1596,62 +3427,448 @@ private:
 #endif
   }
 
-#if defined(BOOST_MSVC)
-/* warning: forcing value to bool 'true' or 'false' in bool(pred()...) */
-#pragma warning(push)
-#pragma warning(disable:4800)
+#if defined(BOOST_MSVC)
+/* warning: forcing value to bool 'true' or 'false' in bool(pred()...) */
+#pragma warning(push)
+#pragma warning(disable:4800)
+#endif
+
+  /* While an incremental rehash is in progress (see migrate_some), elements
+   * can be in either the old or the new arrays. The old arrays are looked up
+   * first: an element is constructed in the new arrays before its old slot is
+   * released (under the old group's exclusive lock), so it can't be missed by
+   * a lookup proceeding in this order.
+   */
+
+  /* With AwaitPublished=std::true_type, lookup waits for insertions in
+   * progress in the probed groups to be published (see emplace_with_hash).
+   */
+
+  template<
+    typename GroupAccessMode,typename Key,typename F,
+    typename AwaitPublished=std::false_type
+  >
+  BOOST_FORCEINLINE bool find_impl(
+    GroupAccessMode access_mode,const Key& x,F f,std::size_t hash,
+    AwaitPublished await_published={})const
+  {
+    if(BOOST_UNLIKELY(migrating())&&
+       find_impl(
+         access_mode,old_arrays,x,f,position_for(hash,old_arrays),hash,
+         await_published)){
+      return true;
+    }
+    return find_impl(
+      access_mode,arrays,x,f,position_for(hash),hash,await_published);
+  }
+
+  template<
+    typename GroupAccessMode,typename Key,typename F,typename AwaitPublished
+  >
+  BOOST_FORCEINLINE bool find_impl(
+    GroupAccessMode access_mode,const arrays_type& arrays_,const Key& x,F f,
+    std::size_t pos0,std::size_t hash,AwaitPublished await_published)const
+  {    
+    prober pb(pos0);
+    do{
+      auto pos=pb.get();
+      auto pg=arrays_.groups+pos;
+      wait_for_publication(pg,await_published);
+      auto mask=pg->match(hash);
+      if(mask){
+        auto p=arrays_.elements+pos*N;
+        prefetch_elements(p);
+        auto lck=access(access_mode,arrays_,pos);
+        do{
+          auto n=unchecked_countr_zero(mask);
+          if(
+            pg->is_occupied(n)&&
+            BOOST_LIKELY(element_matches(x,hash,p[n]))){
+            f(type_policy::value_from(p[n]));
+            BOOST_UNORDERED_CFOA_STATS(
+              add_probe_length(local_stats().lookup_probe_lengths,pb));
+            return true;
+          }
+          BOOST_UNORDERED_CFOA_STATS(add_stat(local_stats().false_matches));
+          mask&=mask-1;
+        }while(mask);
+      }
+      if(BOOST_LIKELY(pg->is_not_overflowed(hash))){
+        BOOST_UNORDERED_CFOA_STATS(
+          add_probe_length(local_stats().lookup_probe_lengths,pb));
+        return false;
+      }
+    }
+    while(BOOST_LIKELY(pb.next(arrays_.groups_size_mask)));
+    BOOST_UNORDERED_CFOA_STATS(
+      add_probe_length(local_stats().lookup_probe_lengths,pb));
+    return false;
+  }
+
+  /* Optimistic lookup copies candidate elements into local storage, so
+   * element_type must be trivially copy constructible and destructible.
+   */
+
+  static constexpr bool optimistic_find_supported=
+#if BOOST_WORKAROUND(BOOST_LIBSTDCXX_VERSION,<50000)
+    boost::has_trivial_copy<element_type>::value&&
+#else
+    std::is_trivially_copy_constructible<element_type>::value&&
+#endif
+    std::is_trivially_destructible<element_type>::value;
+
+  using optimistic_group_access=typename std::conditional<
+    optimistic_find_supported,group_optimistic,group_shared>::type;
+
+#if defined(BOOST_UNORDERED_CFOA_HAS_MMAP)
+  /* same requirements for save_image/load_image */
+
+  static constexpr bool image_supported=optimistic_find_supported;
+#endif
+
+  template<typename FwdIterator,typename F,typename GroupAccessMode>
+  BOOST_FORCEINLINE std::size_t bulk_find(
+    FwdIterator first,FwdIterator last,F f,GroupAccessMode access_mode)
+  {
+    std::size_t res=0;
+    std::size_t hashes[bulk_lookup_size];
+
+    while(first!=last){
+      bool migrated;
+      {
+        auto        lck=shared_access();
+        std::size_t m=0;
+
+        migrated=migrate_some();
+        for(auto it=first;m<bulk_lookup_size&&it!=last;++it,++m){
+          hashes[m]=hash_for(*it);
+          auto pos=position_for(hashes[m]);
+          prefetch(arrays.groups+pos);
+          prefetch_elements(arrays.elements+pos*N);
+        }
+        for(std::size_t i=0;i<m;++i,++first){
+          res+=find_with_hash(access_mode,*first,f,hashes[i]);
+        }
+      }
+      if(BOOST_UNLIKELY(migrated))release_old_arrays();
+    }
+    return res;
+  }
+
+  template<typename GroupAccessMode,typename Key,typename F>
+  BOOST_FORCEINLINE bool find_with_hash(
+    GroupAccessMode access_mode,const Key& x,F& f,std::size_t hash)
+  {
+    return find_impl(access_mode,x,f,hash);
+  }
+
+  template<typename Key,typename F>
+  BOOST_FORCEINLINE bool find_with_hash(
+    group_optimistic,const Key& x,F& f,std::size_t hash)
+  {
+    return
+      (BOOST_UNLIKELY(migrating())&&
+       optimistic_find_impl(
+         old_arrays,x,f,position_for(hash,old_arrays),hash))||
+      optimistic_find_impl(arrays,x,f,position_for(hash),hash);
+  }
+
+  template<typename Key,typename F,typename GroupAccessMode>
+  BOOST_FORCEINLINE bool cfind(const Key& x,F f,GroupAccessMode access_mode)
+  {
+    auto cf=[&](const value_type& v){f(v);};
+    bool migrated,res;
+    {
+      auto lck=shared_access();
+      migrated=migrate_some();
+      res=find_with_hash(access_mode,x,cf,hash_for(x));
+    }
+    if(BOOST_UNLIKELY(migrated))release_old_arrays();
+    return res;
+  }
+
+  /* Seqlock-style lookup: for groups with reduced-hash matches, the group
+   * version is recorded, each candidate element is copied and the version
+   * checked again before the copy is compared and passed to f. If the version
+   * is odd (writer in progress) or has changed, the group is retried. Unlike
+   * find_impl, no group lock is taken, so readers of the same group don't
+   * write to shared cache lines. Groups without matches are dealt with
+   * exactly as in find_impl.
+   */
+
+  template<typename Key,typename F>
+  BOOST_FORCEINLINE bool optimistic_find_impl(
+    const arrays_type& arrays_,const Key& x,F f,
+    std::size_t pos0,std::size_t hash)const
+  {
+    prober pb(pos0);
+    do{
+      auto pos=pb.get();
+      auto pg=arrays_.groups+pos;
+      auto mask=pg->match(hash);
+      if(mask){
+        auto  p=arrays_.elements+pos*N;
+        auto& ver=version(arrays_,pos);
+        prefetch_elements(p);
+      retry:
+        auto v0=ver.load(std::memory_order_acquire);
+        if(BOOST_UNLIKELY(v0&1)){
+          boost::detail::sp_thread_pause();
+          goto retry;
+        }
+        mask=pg->match(hash);
+        /* pairs with the release in group_type::publish */
+        std::atomic_thread_fence(std::memory_order_acquire);
+        while(mask){
+          auto n=unchecked_countr_zero(mask);
+          alignas(element_type) unsigned char buf[sizeof(element_type)];
+          std::memcpy(buf,p+n,sizeof(element_type));
+          std::atomic_thread_fence(std::memory_order_acquire);
+          if(BOOST_UNLIKELY(ver.load(std::memory_order_relaxed)!=v0))goto retry;
+
+          auto& e=*std::launder(reinterpret_cast<element_type*>(buf));
+          if(BOOST_LIKELY(element_matches(x,hash,e))){
+            f(const_cast<const value_type&>(type_policy::value_from(e)));
+            BOOST_UNORDERED_CFOA_STATS(
+              add_probe_length(local_stats().lookup_probe_lengths,pb));
+            return true;
+          }
+          BOOST_UNORDERED_CFOA_STATS(add_stat(local_stats().false_matches));
+          mask&=mask-1;
+        }
+      }
+      if(BOOST_LIKELY(pg->is_not_overflowed(hash))){
+        BOOST_UNORDERED_CFOA_STATS(
+          add_probe_length(local_stats().lookup_probe_lengths,pb));
+        return false;
+      }
+    }
+    while(BOOST_LIKELY(pb.next(arrays_.groups_size_mask)));
+    BOOST_UNORDERED_CFOA_STATS(
+      add_probe_length(local_stats().lookup_probe_lengths,pb));
+    return false;
+  }
+
+  template<typename GroupAccessMode,typename F>
+  std::size_t visit_all_impl(GroupAccessMode access_mode,F& f)
+  {
+    std::size_t res=0;
+    bool        migrated;
+    {
+      auto lck=shared_access();
+      migrated=complete_migration();
+      for(std::size_t pos=0;pos<=arrays.groups_size_mask;++pos){
+        res+=visit_group(access_mode,pos,f);
+      }
+    }
+    if(BOOST_UNLIKELY(migrated))release_old_arrays();
+    return res;
+  }
+
+#if defined(BOOST_UNORDERED_PARALLEL_ALGORITHMS)
+  template<typename GroupAccessMode,typename ExecutionPolicy,typename F>
+  std::size_t visit_all_impl(
+    GroupAccessMode access_mode,ExecutionPolicy&& policy,F& f)
+  {
+    std::atomic<std::size_t> res{0};
+    bool                     migrated;
+    {
+      auto lck=shared_access();
+      migrated=complete_migration();
+      std::for_each(
+        std::forward<ExecutionPolicy>(policy),
+        arrays.groups,arrays.groups+arrays.groups_size_mask+1,
+        [&,this](const typename arrays_type::group_type& g){
+          auto n=visit_group(access_mode,std::size_t(&g-arrays.groups),f);
+          if(n)res.fetch_add(n,std::memory_order_relaxed);
+        });
+    }
+    if(BOOST_UNLIKELY(migrated))release_old_arrays();
+    return res.load(std::memory_order_relaxed);
+  }
 #endif
 
-  template<typename Key,typename F>
-  BOOST_FORCEINLINE bool find_impl(
-    const Key& x,F f,std::size_t pos0,std::size_t hash)const
-  {    
+  template<typename GroupAccessMode,typename F>
+  std::size_t visit_group(GroupAccessMode access_mode,std::size_t pos,F& f)
+  {
+    auto pg=arrays.groups+pos;
+    if(!pg->match_occupied())return 0;
+
+    auto        p=arrays.elements+pos*N;
+    auto        lck=access(access_mode,arrays,pos);
+    auto        mask=pg->match_occupied();
+    std::size_t res=0;
+    while(mask){
+      f(type_policy::value_from(p[unchecked_countr_zero(mask)]));
+      ++res;
+      mask&=mask-1;
+    }
+    return res;
+  }
+
+  template<typename Key,typename Predicate>
+  BOOST_FORCEINLINE std::size_t erase_impl(
+    const Key& x,Predicate pr,std::size_t hash)
+  {
+    if(BOOST_UNLIKELY(migrating())){
+      int res=erase_impl(old_arrays,x,pr,position_for(hash,old_arrays),hash);
+      if(res>=0)return std::size_t(res);
+    }
+    return std::size_t((std::max)(
+      erase_impl(arrays,x,pr,position_for(hash),hash),0));
+  }
+
+  /* returns 1 if erased, 0 if found but not erased and -1 if not found */
+
+  template<typename Key,typename Predicate>
+  BOOST_FORCEINLINE int erase_impl(
+    const arrays_type& arrays_,const Key& x,Predicate pr,
+    std::size_t pos0,std::size_t hash)
+  {
     prober pb(pos0);
     do{
       auto pos=pb.get();
-      auto pg=arrays.groups+pos;
+      auto pg=arrays_.groups+pos;
       auto mask=pg->match(hash);
       if(mask){
-        auto p=arrays.elements+pos*N;
+        auto p=arrays_.elements+pos*N;
         prefetch_elements(p);
-        auto lck=shared_access(pos);
+        auto lck=exclusive_access(arrays_,pos);
         do{
           auto n=unchecked_countr_zero(mask);
           if(
-            pg->at(n)!=0&&
-            BOOST_LIKELY(bool(pred()(x,key_from(p[n]))))){
-            f(p[n]);
-            return true;
+            pg->is_occupied(n)&&
+            BOOST_LIKELY(element_matches(x,hash,p[n]))){
+            if(!pr(type_policy::value_from(p[n])))return 0;
+            destroy_element(p+n);
+            recover_slot(pg,n);
+            return 1;
           }
           mask&=mask-1;
         }while(mask);
       }
       if(BOOST_LIKELY(pg->is_not_overflowed(hash))){
-        return false;
+        return -1;
       }
     }
-    while(BOOST_LIKELY(pb.next(arrays.groups_size_mask)));
-    return false;
+    while(BOOST_LIKELY(pb.next(arrays_.groups_size_mask)));
+    return -1;
   }
 
 #if defined(BOOST_MSVC)
 #pragma warning(pop) /* C4800 */
 #endif
 
-  template<typename F,typename... Args>
-  BOOST_FORCEINLINE bool emplace_impl(F f,Args&&... args)
+  template<typename GroupAccessMode,typename F,typename Key,typename... Args>
+  BOOST_FORCEINLINE void try_emplace_impl(
+    GroupAccessMode access_mode,F& f,Key&& x,Args&&... args)
+  {
+    for(;;){
+      std::size_t n;
+      bool        migrated,res;
+      {
+        auto lck=shared_access();
+        migrated=migrate_some();
+        n=capacity();
+        res=emplace_impl(
+          access_mode,f,try_emplace_args_t{},
+          std::forward<Key>(x),std::forward<Args>(args)...);
+      }
+      if(BOOST_UNLIKELY(migrated))release_old_arrays();
+      if(res)return;
+
+      auto lck=exclusive_access();
+      if(capacity()<=n)unchecked_start_migration(n+1);
+    }
+  }
+
+  template<typename GroupAccessMode,typename F,typename... Args>
+  BOOST_FORCEINLINE bool emplace_impl(
+    GroupAccessMode access_mode,F& f,Args&&... args)
+  {
+    return emplace_with_hash(
+      access_mode,f,hash_for(key_from(args...)),std::forward<Args>(args)...);
+  }
+
+  /* If an element with equivalent key exists, f(x,false) is invoked on it
+   * under the group lock specified by access_mode; newly inserted elements
+   * are passed to f(x,true) before other threads can access them.
+   *
+   * Insertions starting at the same group pos0 are detected through
+   * counter(pos0): if it's changed between the lookup and the slot being
+   * taken, another thread may be inserting an element with the same key,
+   * and we start over.
+   *
+   * With groups supporting it (lock_free_insertion), the slot is claimed
+   * with a CAS on its metadata byte and no group lock is taken: the element
+   * is constructed in the busy slot, which readers skip, and published by
+   * setting its reduced hash, which is the linearization point of insertion
+   * for all lookups, optimistic or not. As the claim precedes the counter
+   * increment, a thread reading counter(pos0) after that increment finds the
+   * slot busy or already published; so that it doesn't miss the element
+   * being inserted, the lookup preceding insertion waits for busy slots in
+   * the groups it probes to be published or released. Otherwise, the target
+   * group is exclusive-locked and the version bump makes optimistic readers
+   * retry.
+   */
+
+  static constexpr bool lock_free_insertion=has_slot_claim<group_type>::value;
+  using lock_free_insertion_type=
+    std::integral_constant<bool,lock_free_insertion>;
+
+  static inline void wait_for_publication(const group_type*,std::false_type){}
+
+  static inline void wait_for_publication(
+    const group_type* pg,std::true_type)
+  {
+    while(BOOST_UNLIKELY(pg->match_busy()))boost::detail::sp_thread_pause();
+  }
+
+  /* Owns a claimed slot until the scope is left: the slot is released if no
+   * element has been constructed in it, and published otherwise, so that no
+   * exit path (exceptions included) leaves it busy and wait_for_publication
+   * spinning forever.
+   */
+
+  struct claimed_slot
+  {
+    ~claimed_slot()
+    {
+      if(constructed)pg->publish(n,hash);
+      else           pg->reset(n);
+    }
+
+    group_type  *pg;
+    std::size_t n;
+    std::size_t hash;
+    bool        constructed=false;
+  };
+
+  template<typename GroupAccessMode,typename F,typename... Args>
+  BOOST_FORCEINLINE bool emplace_with_hash(
+    GroupAccessMode access_mode,F& f,std::size_t hash,Args&&... args)
+  {
+    return emplace_with_hash(
+      lock_free_insertion_type{},access_mode,f,hash,
+      std::forward<Args>(args)...);
+  }
+
+  template<typename GroupAccessMode,typename F,typename... Args>
+  BOOST_FORCEINLINE bool emplace_with_hash(
+    std::false_type /* lock-free insertion */,
+    GroupAccessMode access_mode,F& f,std::size_t hash,Args&&... args)
   {
-    const auto       &k=key_from(std::forward<Args>(args)...);
-    auto             hash=hash_for(k);
+    const auto       &k=key_from(args...);
     auto             pos0=position_for(hash);
 
     for(;;){
     startover:;
       boost::uint32_t group_counter=counter(pos0);
-      if(find_impl(
-        k,[&](value_type& x){f(x,false);},pos0,hash))return true;
+      if(find_impl(access_mode,k,[&](value_type& x){f(x,false);},hash)){
+        return true;
+      }
 
-      if(BOOST_LIKELY(size_<ml)){
+      if(BOOST_LIKELY(below_max_load())){
         for(prober pb(pos0);;pb.next(arrays.groups_size_mask)){
           auto pos=pb.get();
           auto pg=arrays.groups+pos;
@@ -1660,22 +3877,86 @@ private:
             auto lck=exclusive_access(pos);
             do{
               auto n=unchecked_countr_zero(mask);
-              if(pg->at(n)==0){
+              if(!pg->is_occupied(n)){
                 pg->set(n,hash);
                 if(BOOST_UNLIKELY(counter(pos0)++!=group_counter)){
                   /* some other thread inserted from p0, need to start over */
                   pg->reset(n);
+                  BOOST_UNORDERED_CFOA_STATS(
+                    add_stat(local_stats().startovers));
                   goto startover;
                 }
                 auto p=arrays.elements+pos*N+n;
                 construct_element(p,std::forward<Args>(args)...);
-                ++size_;
-                f(*p,true);
+                store_hash(p,hash);
+                update_size(1);
+                BOOST_UNORDERED_CFOA_STATS(
+                  add_probe_length(local_stats().insertion_probe_lengths,pb));
+                f(type_policy::value_from(*p),true);
                 return true;
               }
               mask&=mask-1;
             }while(mask);
           }
+          BOOST_UNORDERED_CFOA_STATS(count_overflow(pg,hash));
+          pg->mark_overflow(hash);
+        }
+      }
+      else return false;
+    }
+  }
+
+  template<typename GroupAccessMode,typename F,typename... Args>
+  BOOST_FORCEINLINE bool emplace_with_hash(
+    std::true_type /* lock-free insertion */,
+    GroupAccessMode access_mode,F& f,std::size_t hash,Args&&... args)
+  {
+    const auto       &k=key_from(args...);
+    auto             pos0=position_for(hash);
+
+    for(;;){
+    startover:;
+      boost::uint32_t group_counter=counter(pos0);
+      if(find_impl(
+           access_mode,k,[&](value_type& x){f(x,false);},hash,
+           std::true_type{})){
+        return true;
+      }
+
+      if(BOOST_LIKELY(below_max_load())){
+        for(prober pb(pos0);;pb.next(arrays.groups_size_mask)){
+          auto pos=pb.get();
+          auto pg=arrays.groups+pos;
+          auto mask=pg->match_available();
+          while(mask){
+            auto n=unchecked_countr_zero(mask);
+            if(pg->claim(n)){
+              claimed_slot slot{pg,n,hash};
+              if(BOOST_UNLIKELY(counter(pos0)++!=group_counter)){
+                /* some other thread inserted from p0, need to start over */
+                BOOST_UNORDERED_CFOA_STATS(
+                  add_stat(local_stats().startovers));
+                goto startover;
+              }
+              auto p=arrays.elements+pos*N+n;
+              construct_element(p,std::forward<Args>(args)...);
+              store_hash(p,hash);
+              slot.constructed=true;
+              update_size(1);
+              BOOST_UNORDERED_CFOA_STATS(
+                add_probe_length(local_stats().insertion_probe_lengths,pb));
+
+              /* f runs before the slot is published (on leaving the scope,
+               * even if f throws), so no other thread sees the element
+               * until f is done with it.
+               */
+
+              f(type_policy::value_from(*p),true);
+              return true;
+            }
+            mask&=mask-1;
+          }
+          BOOST_UNORDERED_CFOA_STATS(count_overflow(pg,hash));
           pg->mark_overflow(hash);
         }
       }
@@ -1702,8 +3983,9 @@ private:
      * element having caused overflow; P has been measured as ~0.162 under
      * ideal conditions, yielding F ~ 0.0165 ~ 1/61.
      */
+    auto     size=this->size();
     auto     new_arrays_=new_arrays(std::size_t(
-               std::ceil(static_cast<float>(size_+size_/61+1)/mlf)));
+               std::ceil(static_cast<float>(size+size/61+1)/mlf)));
     iterator it;
     BOOST_TRY{
       /* strong exception guarantee -> try insertion before rehash */
@@ -1731,6 +4013,7 @@ private:
 
   BOOST_NOINLINE void unchecked_rehash(arrays_type& new_arrays_)
   {
+    BOOST_UNORDERED_CFOA_STATS(auto t0=std::chrono::steady_clock::now());
     std::size_t num_destroyed=0;
     BOOST_TRY{
       for_all_elements([&,this](element_type* p){
@@ -1764,6 +4047,255 @@ private:
     delete_arrays(arrays);
     arrays=new_arrays_;
     ml=initial_max_load();
+    BOOST_UNORDERED_CFOA_STATS(add_rehash(std::chrono::steady_clock::now()-t0));
+  }
+
+  /* Incremental rehash: when the table reaches its maximum load,
+   * unchecked_start_migration briefly stops the world to allocate the new
+   * arrays, which from then on receive all insertions, and leaves the old ones
+   * in place. Subsequent lookup and insertion operations (all under
+   * shared_access()) call migrate_some, which claims the next
+   * groups_per_migration_step groups of the old arrays and transfers their
+   * elements to the new arrays, so that migration cost is spread across
+   * operations and threads rather than paid by a single thread while all the
+   * others are blocked. Migrated old groups keep their overflow bytes so that
+   * probing across them still reaches not-yet-migrated elements. The thread
+   * completing the migration releases the old arrays (again under
+   * exclusive_access(), but without moving any element).
+   */
+
+  static constexpr std::size_t groups_per_migration_step=4;
+
+  bool migrating()const noexcept
+  {
+    return migrating_.load(std::memory_order_acquire);
+  }
+
+  /* returns true if this call completed the migration */
+
+  BOOST_FORCEINLINE bool migrate_some()
+  {
+    if(BOOST_LIKELY(!migrating()))return false;
+    return migrate_some_groups();
+  }
+
+  BOOST_NOINLINE bool migrate_some_groups()
+  {
+    auto size=old_arrays.groups_size_mask+1;
+    auto first=migration.next.fetch_add(
+      groups_per_migration_step,std::memory_order_relaxed);
+    if(first>=size)return false;
+
+    auto last=(std::min)(first+groups_per_migration_step,size);
+    for(auto pos=first;pos<last;++pos)migrate_group(pos);
+    if(migration.done.fetch_add(last-first,std::memory_order_acq_rel)+
+       (last-first)==size){
+      BOOST_UNORDERED_CFOA_STATS(
+        add_rehash(std::chrono::steady_clock::now()-migration_start));
+      migrating_.store(false,std::memory_order_release);
+      return true;
+    }
+    return false;
+  }
+
+  void migrate_group(std::size_t pos)
+  {
+    auto pg=old_arrays.groups+pos;
+    auto p=old_arrays.elements+pos*N;
+    auto lck=exclusive_access(old_arrays,pos);
+    auto mask=pg->match_occupied();
+    while(mask){
+      auto n=unchecked_countr_zero(mask);
+      migrate_element(p+n);
+      pg->reset(n);
+      mask&=mask-1;
+    }
+  }
+
+  void migrate_element(element_type* p)
+  {
+    using moved_element_type=
+      decltype(type_policy::move(std::declval<element_type&>()));
+
+    auto hash=hash_for_element(*p);
+    if_constexpr<
+      std::is_nothrow_constructible<element_type,moved_element_type>::value||
+      !std::is_copy_constructible<element_type>::value
+    >([&,this]{
+      destroy_element_on_exit d{this,p};
+      (void)d; /* unused var warning */
+      nosize_concurrent_emplace_at(
+        arrays,position_for(hash),hash,type_policy::move(*p));
+    },
+    [&,this]{ /* else */
+      nosize_concurrent_emplace_at(
+        arrays,position_for(hash),hash,const_cast<const element_type&>(*p));
+      destroy_element(p);
+    });
+  }
+
+  template<typename... Args>
+  void nosize_concurrent_emplace_at(
+    const arrays_type& arrays_,std::size_t pos0,std::size_t hash,
+    Args&&... args)
+  {
+    nosize_concurrent_emplace_at(
+      lock_free_insertion_type{},arrays_,pos0,hash,
+      std::forward<Args>(args)...);
+  }
+
+  template<typename... Args>
+  void nosize_concurrent_emplace_at(
+    std::true_type /* lock-free insertion */,
+    const arrays_type& arrays_,std::size_t pos0,std::size_t hash,
+    Args&&... args)
+  {
+    for(prober pb(pos0);;pb.next(arrays_.groups_size_mask)){
+      auto pos=pb.get();
+      auto pg=arrays_.groups+pos;
+      auto mask=pg->match_available();
+      while(mask){
+        auto n=unchecked_countr_zero(mask);
+        if(pg->claim(n)){
+          claimed_slot slot{pg,n,hash};
+          auto         p=arrays_.elements+pos*N+n;
+          construct_element(p,std::forward<Args>(args)...);
+          store_hash(p,hash);
+          slot.constructed=true;
+          return;
+        }
+        mask&=mask-1;
+      }
+      BOOST_UNORDERED_CFOA_STATS(count_overflow(pg,hash));
+      pg->mark_overflow(hash);
+    }
+  }
+
+  template<typename... Args>
+  void nosize_concurrent_emplace_at(
+    std::false_type /* lock-free insertion */,
+    const arrays_type& arrays_,std::size_t pos0,std::size_t hash,
+    Args&&... args)
+  {
+    for(prober pb(pos0);;pb.next(arrays_.groups_size_mask)){
+      auto pos=pb.get();
+      auto pg=arrays_.groups+pos;
+      auto mask=pg->match_available();
+      if(BOOST_LIKELY(mask!=0)){
+        auto lck=exclusive_access(arrays_,pos);
+        do{
+          auto n=unchecked_countr_zero(mask);
+          if(!pg->is_occupied(n)){
+            auto p=arrays_.elements+pos*N+n;
+            construct_element(p,std::forward<Args>(args)...);
+            store_hash(p,hash);
+            pg->set(n,hash);
+            return;
+          }
+          mask&=mask-1;
+        }while(mask);
+      }
+      BOOST_UNORDERED_CFOA_STATS(count_overflow(pg,hash));
+      pg->mark_overflow(hash);
+    }
+  }
+
+  /* Helps complete an ongoing migration and waits for other threads to finish
+   * the groups they've claimed. Returns true if this thread completed the
+   * migration.
+   * pre: shared_access()
+   */
+
+  bool complete_migration()
+  {
+    bool res=false;
+    while(migrating()){
+      if(migrate_some_groups())res=true;
+      else boost::detail::sp_thread_pause();
+    }
+    return res;
+  }
+
+  BOOST_NOINLINE void unchecked_start_migration(std::size_t n)
+  {
+    /* pre: exclusive_access() */
+
+    finish_migration();
+    BOOST_UNORDERED_CFOA_STATS(migration_start=std::chrono::steady_clock::now());
+    if(!arrays.elements){
+      rehash(n);
+      return;
+    }
+
+    auto m=size_t(std::ceil(float(size())/mlf));
+    if(m>n)n=m;
+    old_arrays=arrays;
+    BOOST_TRY{
+      arrays=new_arrays(capacity_for(n));
+    }
+    BOOST_CATCH(...){
+      old_arrays={};
+      BOOST_RETHROW
+    }
+    BOOST_CATCH_END
+    ml=initial_max_load();
+    migration.next=0;
+    migration.done=0;
+    migrating_=true;
+  }
+
+  void finish_migration()
+  {
+    /* pre: exclusive_access() or no concurrent operations */
+
+    if(migrating()){
+      for(std::size_t pos=0;pos<=old_arrays.groups_size_mask;++pos){
+        /* skip groups already migrated, possibly in parallel (see below) */
+        if(old_arrays.groups[pos].match_occupied())migrate_group(pos);
+      }
+      BOOST_UNORDERED_CFOA_STATS(
+        add_rehash(std::chrono::steady_clock::now()-migration_start));
+      migrating_=false;
+    }
+    delete_arrays(old_arrays);
+    old_arrays={};
+  }
+
+#if defined(BOOST_UNORDERED_PARALLEL_ALGORITHMS)
+  template<typename ExecutionPolicy>
+  void finish_migration(ExecutionPolicy&& policy)
+  {
+    /* pre: no concurrent operations */
+
+    if(migrating()){
+      std::for_each(
+        std::forward<ExecutionPolicy>(policy),
+        old_arrays.groups,old_arrays.groups+old_arrays.groups_size_mask+1,
+        [this](const typename arrays_type::group_type& g){
+          migrate_group(std::size_t(&g-old_arrays.groups));
+        });
+    }
+    finish_migration();
+  }
+#endif
+
+  BOOST_NOINLINE void release_old_arrays()
+  {
+    auto lck=exclusive_access();
+    if(!migrating())finish_migration();
+  }
+
+  void swap_migration(table& x)
+  {
+    using std::swap;
+    swap(old_arrays,x.old_arrays);
+    swap_atomic(migrating_,x.migrating_);
+    swap_atomic(migration.next,x.migration.next);
+    swap_atomic(migration.done,x.migration.done);
+#if defined(BOOST_UNORDERED_CFOA_HAS_MMAP)
+    /* goes along with elements referring to its arena */
+    swap(image,x.image);
+#endif
   }
 
   void noshrink_reserve(std::size_t n)
@@ -1791,6 +4323,12 @@ private:
     unchecked_emplace_at(position_for(hash),hash,std::forward<Element>(x));
   }
 
+  void unchecked_insert(const element_type& x)
+  {
+    auto hash=hash_for_element(x);
+    unchecked_emplace_at(position_for(hash),hash,x);
+  }
+
   void nosize_transfer_element(
     element_type* p,const arrays_type& arrays_,std::size_t& num_destroyed)
   {
@@ -1798,7 +4336,7 @@ private:
       decltype(type_policy::move(std::declval<element_type&>()));
 
     nosize_transfer_element(
-      p,hash_for(key_from(*p)),arrays_,num_destroyed,
+      p,hash_for_element(*p),arrays_,num_destroyed,
       std::integral_constant< /* std::move_if_noexcept semantics */
         bool,
 
@@ -1856,6 +4394,7 @@ private:
         auto n=unchecked_countr_zero(mask);
         auto p=arrays_.elements+pos*N+n;
         construct_element(p,std::forward<Args>(args)...);
+        store_hash(p,hash);
         pg->set(n,hash);
         return {pg,n,p};
       }
@@ -1866,16 +4405,55 @@ private:
   template<typename Predicate>
   std::size_t erase_if_impl(Predicate pr)
   {
-    std::size_t s=size();
-    for_all_elements([&,this](group_type* pg,unsigned int n,element_type* p){
-      if(pr(*p)) erase(iterator{pg,n,p});
-    });
-    return std::size_t(s-size());
+    /* Groups are visited one at a time under exclusive access, so concurrent
+     * lookups and insertions only block on the group being currently
+     * processed. If an incremental rehash is in progress, an element migrated
+     * after being visited in the old arrays can be visited again in the new
+     * ones, so pr is expected to yield the same result when called twice.
+     */
+
+    std::size_t res;
+    {
+      auto lck=shared_access();
+      res=
+        (migrating()?erase_if_impl(old_arrays,pr):0)+erase_if_impl(arrays,pr);
+    }
+    if(res&&below_min_load())shrink_on_erasure();
+    return res;
+  }
+
+  template<typename Predicate>
+  std::size_t erase_if_impl(const arrays_type& arrays_,Predicate pr)
+  {
+    std::size_t s=0;
+    auto        p=boost::to_address(arrays_.elements);
+    if(!p)return 0;
+    for(std::size_t pos=0;pos<=arrays_.groups_size_mask;++pos,p+=N){
+      auto pg=arrays_.groups+pos;
+      if(!pg->match_occupied())continue;
+      auto lck=exclusive_access(arrays_,pos);
+      auto mask=pg->match_occupied();
+      while(mask){
+        auto n=unchecked_countr_zero(mask);
+        if(pr(type_policy::value_from(p[n]))){
+          destroy_element(p+n);
+          recover_slot(pg,n);
+          ++s;
+        }
+        mask&=mask-1;
+      }
+    }
+    return s;
   }
 
+  /* Elements not yet migrated by an ongoing incremental rehash are visited
+   * too.
+   */
+
   template<typename F>
   void for_all_elements(F f)const
   {
+    for_all_elements(old_arrays,f);
     for_all_elements(arrays,f);
   }
 
@@ -1913,9 +4491,10 @@ private:
   static auto for_all_elements_while(const arrays_type& arrays_,F f)
     ->decltype(f(nullptr,0,nullptr),void())
   {
-    auto p=arrays_.elements;
+    auto p=boost::to_address(arrays_.elements);
     if(!p){return;}
-    for(auto pg=arrays_.groups,last=pg+arrays_.groups_size_mask+1;
+    for(auto pg=boost::to_address(arrays_.groups),
+             last=pg+arrays_.groups_size_mask+1;
         pg!=last;++pg,p+=N){
       auto mask=pg->match_occupied();
       while(mask){
@@ -1929,20 +4508,39 @@ private:
   std::atomic<std::size_t> size_;
   arrays_type              arrays;
   std::atomic<std::size_t> ml;
+  arrays_type              old_arrays={};
+  std::atomic<bool>        migrating_={false};
+  float                    min_lf=0.0f;
+
+  struct alignas(64) migration_counters
+  {
+    std::atomic<std::size_t> next={0};
+    std::atomic<std::size_t> done={0};
+  };
+  migration_counters       migration;
+#if defined(BOOST_UNORDERED_CFOA_HAS_MMAP)
+  table_image_mapping      image; /* loaded by load_image */
+#endif
 
   using mutex_type=Mutex;
   static constexpr std::size_t num_mutexes=128;
   struct aligned_mutex
   {
     alignas(64) mutable mutex_type mtx;
+    std::atomic<std::ptrdiff_t>    size_delta={0};
   };
 
-  std::shared_lock<mutex_type> shared_access()const
+  std::size_t stripe_index()const
   {
     thread_local auto       id=(++thread_counter)%num_mutexes;
     //thread_local auto id=std::hash<std::thread::id>()(std::this_thread::get_id())%num_mutexes;
 
-    return std::shared_lock<mutex_type>{mutexes[id].mtx};
+    return id;
+  }
+
+  std::shared_lock<mutex_type> shared_access()const
+  {
+    return std::shared_lock<mutex_type>{mutexes[stripe_index()].mtx};
   }
 
   struct exclusive_access_struct
@@ -1967,6 +4565,53 @@ private:
 
   mutable std::atomic_uint              thread_counter=0;
   std::array<aligned_mutex,num_mutexes> mutexes;
+
+#if defined(BOOST_UNORDERED_CFOA_ENABLE_STATS)
+  /* per-thread counters, striped as mutexes and merged by get_stats() */
+
+  struct alignas(64) stats_stripe
+  {
+    using counter=std::atomic<std::size_t>;
+
+    counter                   lookup_probe_lengths[stats_probe_length_buckets]={};
+    counter                   insertion_probe_lengths[stats_probe_length_buckets]={};
+    counter                   false_matches={0};
+    counter                   startovers={0};
+    counter                   overflow_bits_set={0};
+    counter                   rehashes={0};
+    std::atomic<std::int64_t> rehash_time={0}; /* ns */
+  };
+
+  stats_stripe& local_stats()const{return stats[stripe_index()];}
+
+  static void add_stat(std::atomic<std::size_t>& x)
+  {
+    x.fetch_add(1,std::memory_order_relaxed);
+  }
+
+  static void add_probe_length(
+    std::atomic<std::size_t>* histogram,const prober& pb)
+  {
+    add_stat(histogram[(std::min)(pb.length(),stats_probe_length_buckets)-1]);
+  }
+
+  void count_overflow(const group_type* pg,std::size_t hash)const
+  {
+    if(pg->is_not_overflowed(hash))add_stat(local_stats().overflow_bits_set);
+  }
+
+  void add_rehash(std::chrono::steady_clock::duration d)const
+  {
+    auto& s=local_stats();
+    add_stat(s.rehashes);
+    s.rehash_time.fetch_add(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(d).count(),
+      std::memory_order_relaxed);
+  }
+
+  mutable std::array<stats_stripe,num_mutexes> stats;
+  std::chrono::steady_clock::time_point        migration_start;
+#endif
 };
 
 #if BOOST_WORKAROUND(BOOST_MSVC,<=1900)
@@ -1995,4 +4640,17 @@ private:
 #ifdef BOOST_UNORDERED_SSE2
 #undef BOOST_UNORDERED_SSE2
 #endif
+#ifdef BOOST_UNORDERED_AVX2
+#undef BOOST_UNORDERED_AVX2
+#endif
+#ifdef BOOST_UNORDERED_AVX512BW
+#undef BOOST_UNORDERED_AVX512BW
+#endif
+#ifdef BOOST_UNORDERED_PARALLEL_ALGORITHMS
+#undef BOOST_UNORDERED_PARALLEL_ALGORITHMS
+#endif
+#undef BOOST_UNORDERED_CFOA_STATS
+#ifdef BOOST_UNORDERED_CFOA_HAS_MMAP
+#undef BOOST_UNORDERED_CFOA_HAS_MMAP
+#endif
 #endif
@@ -0,0 +1,159 @@
+#ifndef COMBINING_COUNTER_HPP_INCLUDED
+#define COMBINING_COUNTER_HPP_INCLUDED
+
+// Copyright 2026 agent
+// Distributed under the Boost Software License, Version 1.0.
+// https://www.boost.org/LICENSE_1_0.txt
+
+#include <boost/unordered/unordered_flat_map.hpp>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A combining front-end for counting into a concurrent Table: each thread
+// accumulates deltas into a private boost::unordered_flat_map and applies
+// them to the shared table in one go when the private map reaches
+// local_capacity keys, so that hot keys are updated once per batch rather
+// than on every call, and threads no longer fight over their groups.
+//
+// Until flushed, deltas are not visible in the table; flush() applies the
+// pending deltas of all threads and must not run concurrently with add()
+// (e.g. it's called after the adding threads have been joined.) Keys are
+// stored in the private maps as Table::key_type, so for non-owning keys such
+// as std::string_view the referenced data must outlive the flush.
+
+template<class Table, class Delta = std::size_t> class combining_counter
+{
+private:
+
+    using key_type = typename Table::key_type;
+    using local_map = boost::unordered_flat_map<key_type, Delta, typename Table::hasher, typename Table::key_equal>;
+
+    struct alignas(64) local_buffer
+    {
+        std::thread::id owner;
+        local_map map;
+    };
+
+    Table& table_;
+    std::size_t local_capacity_;
+
+    // distinguishes this counter in the thread-local cache of local()
+
+    std::size_t id_;
+
+    std::mutex mtx_;
+    std::vector<std::unique_ptr<local_buffer>> buffers_;
+
+    static std::size_t next_id()
+    {
+        static std::atomic<std::size_t> n = 0;
+        return ++n;
+    }
+
+    local_buffer& local()
+    {
+        thread_local std::size_t cached_id = 0;
+        thread_local local_buffer* cached = nullptr;
+
+        if( cached_id != id_ )
+        {
+            std::lock_guard<std::mutex> lock( mtx_ );
+
+            auto tid = std::this_thread::get_id();
+            cached = nullptr;
+
+            for( auto& p: buffers_ )
+            {
+                if( p->owner == tid )
+                {
+                    cached = p.get();
+                    break;
+                }
+            }
+
+            if( cached == nullptr )
+            {
+                buffers_.push_back( std::make_unique<local_buffer>() );
+
+                cached = buffers_.back().get();
+                cached->owner = tid;
+                cached->map.reserve( local_capacity_ );
+            }
+
+            cached_id = id_;
+        }
+
+        return *cached;
+    }
+
+    void flush( local_map& map )
+    {
+        for( auto const& x: map )
+        {
+            Delta d = x.second;
+
+            table_.try_emplace(
+                [d]( auto& y, bool ){ y.second += d; },
+                x.first, 0 );
+        }
+
+        map.clear();
+    }
+
+public:
+
+    explicit combining_counter( Table& table, std::size_t local_capacity = 4096 ):
+        table_( table ), local_capacity_( local_capacity ), id_( next_id() )
+    {
+    }
+
+    combining_counter( combining_counter const& ) = delete;
+    combining_counter& operator=( combining_counter const& ) = delete;
+
+    ~combining_counter()
+    {
+        flush();
+    }
+
+    Table& table() noexcept
+    {
+        return table_;
+    }
+
+    void add( key_type const& k, Delta d = 1 )
+    {
+        auto& map = local().map;
+
+        map[ k ] += d;
+
+        if( map.size() >= local_capacity_ )
+        {
+            flush( map );
+        }
+    }
+
+    // applies the pending deltas of the calling thread
+
+    void flush_local()
+    {
+        flush( local().map );
+    }
+
+    // applies the pending deltas of all threads; no concurrent add()
+
+    void flush()
+    {
+        std::lock_guard<std::mutex> lock( mtx_ );
+
+        for( auto& p: buffers_ )
+        {
+            flush( p->map );
+        }
+    }
+};
+
+#endif // #ifndef COMBINING_COUNTER_HPP_INCLUDED
@@ -0,0 +1,148 @@
+#ifndef HUGE_PAGE_ALLOCATOR_HPP_INCLUDED
+#define HUGE_PAGE_ALLOCATOR_HPP_INCLUDED
+
+// Copyright 2026 agent
+// Distributed under the Boost Software License, Version 1.0.
+// https://www.boost.org/LICENSE_1_0.txt
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+// An allocator placing large blocks on 2MB huge pages, to reduce dTLB
+// misses on multi-gigabyte tables where every probe touches a random page.
+//
+// Blocks of at least huge_page_size bytes are mmap'ed, first asking for
+// explicit huge pages (MAP_HUGETLB, which requires a reserved pool in
+// /proc/sys/vm/nr_hugepages) and, failing that, for a 2MB aligned anonymous
+// mapping advised with MADV_HUGEPAGE, so that transparent huge pages back it
+// when enabled. Smaller blocks, and all blocks on non-Linux systems, go to
+// std::allocator.
+
+template<class T> class huge_page_allocator
+{
+public:
+
+    using value_type = T;
+
+    static constexpr std::size_t huge_page_size = std::size_t( 2 ) << 20;
+
+    huge_page_allocator() = default;
+
+    template<class U> huge_page_allocator( huge_page_allocator<U> const& ) noexcept
+    {
+    }
+
+    T* allocate( std::size_t n )
+    {
+        if( n > std::size_t( -1 ) / sizeof( T ) )
+        {
+            throw std::bad_array_new_length();
+        }
+
+#if defined(__linux__)
+
+        std::size_t size = n * sizeof( T );
+
+        if( size >= huge_page_size )
+        {
+            return static_cast<T*>( allocate_huge( mapping_size( size ) ) );
+        }
+
+#endif
+
+        return std::allocator<T>().allocate( n );
+    }
+
+    void deallocate( T* p, std::size_t n ) noexcept
+    {
+#if defined(__linux__)
+
+        std::size_t size = n * sizeof( T );
+
+        if( size >= huge_page_size )
+        {
+            ::munmap( p, mapping_size( size ) );
+            return;
+        }
+
+#endif
+
+        std::allocator<T>().deallocate( p, n );
+    }
+
+    friend bool operator==( huge_page_allocator const&, huge_page_allocator const& ) noexcept
+    {
+        return true;
+    }
+
+    friend bool operator!=( huge_page_allocator const&, huge_page_allocator const& ) noexcept
+    {
+        return false;
+    }
+
+private:
+
+    static std::size_t mapping_size( std::size_t size ) noexcept
+    {
+        return ( size + huge_page_size - 1 ) & ~( huge_page_size - 1 );
+    }
+
+#if defined(__linux__)
+
+    static void* allocate_huge( std::size_t size )
+    {
+        void* p;
+
+#if defined(MAP_HUGETLB)
+
+        p = ::mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+
+        if( p != MAP_FAILED ) return p;
+
+#endif
+
+        // transparent huge pages only back 2MB aligned ranges, so we
+        // overallocate by one huge page and trim both ends
+
+        std::size_t size2 = size + huge_page_size;
+
+        void* q = ::mmap( nullptr, size2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+
+        if( q == MAP_FAILED ) throw std::bad_alloc();
+
+        auto first = reinterpret_cast<std::uintptr_t>( q );
+        auto aligned = ( first + huge_page_size - 1 ) & ~std::uintptr_t( huge_page_size - 1 );
+
+        if( aligned != first )
+        {
+            ::munmap( q, aligned - first );
+        }
+
+        if( aligned + size != first + size2 )
+        {
+            ::munmap( reinterpret_cast<void*>( aligned + size ), first + size2 - aligned - size );
+        }
+
+        p = reinterpret_cast<void*>( aligned );
+
+#if defined(MADV_HUGEPAGE)
+
+        // failure only means we get regular pages
+
+        ::madvise( p, size, MADV_HUGEPAGE );
+
+#endif
+
+        return p;
+    }
+
+#endif
+};
+
+#endif // #ifndef HUGE_PAGE_ALLOCATOR_HPP_INCLUDED
@@ -0,0 +1,140 @@
+#ifndef HYPERLOGLOG_HPP_INCLUDED
+#define HYPERLOGLOG_HPP_INCLUDED
+
+// Copyright 2026 agent
+// Distributed under the Boost Software License, Version 1.0.
+// https://www.boost.org/LICENSE_1_0.txt
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+// HyperLogLog distinct count estimator, with 2^P one-byte registers and a
+// standard error of about 1.04 / sqrt(2^P) (0.8% for the default P = 14)
+
+template<int P = 14> class hyperloglog
+{
+private:
+
+    static_assert( P >= 4 && P <= 18, "P must be in [4, 18]" );
+
+    static constexpr std::size_t M = std::size_t( 1 ) << P;
+
+    unsigned char registers_[ M ] = {};
+
+    // input hashes need not be avalanching
+
+    static std::uint64_t mix( std::uint64_t x ) noexcept
+    {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+
+        return x;
+    }
+
+public:
+
+    void add( std::uint64_t hash ) noexcept
+    {
+        std::uint64_t h = mix( hash );
+
+        std::size_t i = static_cast<std::size_t>( h >> ( 64 - P ) );
+
+        // rank of the first 1 bit in the remaining 64 - P bits, 1-based;
+        // the sentinel bit caps it at 64 - P + 1
+
+        std::uint64_t w = ( h << P ) | ( std::uint64_t( 1 ) << ( P - 1 ) );
+
+        unsigned char r = 1;
+
+        while( !( w & 0x8000'0000'0000'0000ULL ) )
+        {
+            w <<= 1;
+            ++r;
+        }
+
+        if( r > registers_[ i ] ) registers_[ i ] = r;
+    }
+
+    void merge( hyperloglog const& x ) noexcept
+    {
+        for( std::size_t i = 0; i < M; ++i )
+        {
+            registers_[ i ] = (std::max)( registers_[ i ], x.registers_[ i ] );
+        }
+    }
+
+    double estimate() const noexcept
+    {
+        double const m = double( M );
+        double const alpha = 0.7213 / ( 1.0 + 1.079 / m );
+
+        double sum = 0;
+        std::size_t zeros = 0;
+
+        for( std::size_t i = 0; i < M; ++i )
+        {
+            sum += std::ldexp( 1.0, -registers_[ i ] );
+            zeros += registers_[ i ] == 0;
+        }
+
+        double e = alpha * m * m / sum;
+
+        if( e <= 2.5 * m && zeros != 0 )
+        {
+            // small range correction: linear counting
+
+            e = m * std::log( m / double( zeros ) );
+        }
+
+        return e;
+    }
+};
+
+// Estimates the number of distinct elements in [first, last) in a single
+// pass split among num_threads threads, each feeding its own estimator
+
+template<class RandomIt, class Hash> std::size_t estimate_distinct( RandomIt first, RandomIt last, Hash const& hash, std::size_t num_threads )
+{
+    using estimator = hyperloglog<>;
+
+    std::size_t n = static_cast<std::size_t>( std::distance( first, last ) );
+
+    if( num_threads == 0 ) num_threads = 1;
+
+    std::vector<estimator> hll( num_threads );
+    std::vector<std::thread> th( num_threads );
+
+    std::size_t m = n / num_threads;
+
+    for( std::size_t i = 0; i < num_threads; ++i )
+    {
+        th[ i ] = std::thread( [&, i]{
+
+            std::size_t start = i * m;
+            std::size_t end = i == num_threads - 1? n: (i + 1) * m;
+
+            for( std::size_t j = start; j < end; ++j )
+            {
+                hll[ i ].add( hash( first[ j ] ) );
+            }
+        });
+    }
+
+    for( std::size_t i = 0; i < num_threads; ++i )
+    {
+        th[ i ].join();
+        if( i != 0 ) hll[ 0 ].merge( hll[ i ] );
+    }
+
+    return static_cast<std::size_t>( hll[ 0 ].estimate() + 0.5 );
+}
+
+#endif // #ifndef HYPERLOGLOG_HPP_INCLUDED
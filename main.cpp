@@ -11,6 +11,7 @@
 #include <vector>
 #include <memory>
 #include <cstdint>
+#include <cstdio>
 #include <iostream>
 #include <iomanip>
 #include <chrono>
@@ -21,16 +22,45 @@
 #include <thread>
 #include <atomic>
 #include <shared_mutex>
+#include <execution>
 #include "rw_spinlock.hpp"
+#include "queued_rw_lock.hpp"
+#include "huge_page_allocator.hpp"
+#include "hyperloglog.hpp"
+#include "short_string_hash.hpp"
+#include "combining_counter.hpp"
 #include "cfoa.hpp"
 #include "cuckoohash_map.hh"
 #include "oneapi/tbb/concurrent_hash_map.h"
 #include "oneapi/tbb/spin_rw_mutex.h"
 #include "gtl/phmap.hpp"
 
+#if defined(__unix__)
+#include <boost/interprocess/managed_shared_memory.hpp>
+#include <boost/interprocess/allocators/allocator.hpp>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
 int const Th = 16; // number of threads
 int const Sh = 512; // number of shards
 
+// hash function used for words by all the maps (and for sharding), except
+// where noted; -DUSE_SHORT_STRING_HASH switches all of them to
+// short_string_hash
+
+#if defined(USE_SHORT_STRING_HASH)
+using word_hash = short_string_hash;
+#else
+using word_hash = boost::hash<std::string_view>;
+#endif
+
 using namespace std::chrono_literals;
 
 static void print_time( std::chrono::steady_clock::time_point & t1, char const* label, std::size_t s, std::size_t size )
@@ -120,19 +150,73 @@ struct map_policy
 
 // map types
 
-using ufm_map_type = boost::unordered_flat_map<std::string_view, std::size_t>;
+using ufm_map_type = boost::unordered_flat_map<std::string_view, std::size_t, word_hash>;
+
+using cfoa_map_type = boost::unordered::detail::cfoa::table<map_policy<std::string_view, std::size_t>, word_hash, std::equal_to<std::string_view>, std::allocator<std::pair<const std::string_view,int>>>;
+using cfoa_tbb_map_type = boost::unordered::detail::cfoa::table<map_policy<std::string_view, std::size_t>, word_hash, std::equal_to<std::string_view>, std::allocator<std::pair<const std::string_view,int>>, tbb::spin_rw_mutex>;
+using cfoa_shm_map_type = boost::unordered::detail::cfoa::table<map_policy<std::string_view, std::size_t>, word_hash, std::equal_to<std::string_view>, std::allocator<std::pair<const std::string_view,int>>, std::shared_mutex>;
+using cfoa_qrw_map_type = boost::unordered::detail::cfoa::table<map_policy<std::string_view, std::size_t>, word_hash, std::equal_to<std::string_view>, std::allocator<std::pair<const std::string_view,int>>, queued_rw_lock>;
+using cfoa_hashed_map_type = boost::unordered::detail::cfoa::table<boost::unordered::detail::cfoa::stored_hash_type_policy<map_policy<std::string_view, std::size_t>>, word_hash, std::equal_to<std::string_view>, std::allocator<std::pair<const std::string_view,int>>>;
+using cfoa_ssh_map_type = boost::unordered::detail::cfoa::table<map_policy<std::string_view, std::size_t>, short_string_hash, std::equal_to<std::string_view>, std::allocator<std::pair<const std::string_view,int>>>;
+using cfoa_huge_map_type = boost::unordered::detail::cfoa::table<map_policy<std::string_view, std::size_t>, word_hash, std::equal_to<std::string_view>, huge_page_allocator<std::pair<const std::string_view,int>>>;
+
+template<class Group> using cfoa_group_map_type = boost::unordered::detail::cfoa::table<map_policy<std::string_view, std::size_t>, word_hash, std::equal_to<std::string_view>, std::allocator<std::pair<const std::string_view,int>>, rw_spinlock, Group>;
+
+using cfoa_swar_map_type = cfoa_group_map_type<boost::unordered::detail::cfoa::swar_group15>;
+
+// cfoa.hpp #undefs BOOST_UNORDERED_SSE2 at its end, so its test is repeated
+// here
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+
+// group15 with slot claiming hidden, so that the table inserts under the
+// group's exclusive lock rather than lock-free
+
+struct locked_group15: boost::unordered::detail::cfoa::group15
+{
+    bool claim( std::size_t ) = delete;
+};
+
+using cfoa_locked_map_type = cfoa_group_map_type<locked_group15>;
+
+#endif
 
-using cfoa_map_type = boost::unordered::detail::cfoa::table<map_policy<std::string_view, std::size_t>, boost::hash<std::string_view>, std::equal_to<std::string_view>, std::allocator<std::pair<const std::string_view,int>>>;
-using cfoa_tbb_map_type = boost::unordered::detail::cfoa::table<map_policy<std::string_view, std::size_t>, boost::hash<std::string_view>, std::equal_to<std::string_view>, std::allocator<std::pair<const std::string_view,int>>, tbb::spin_rw_mutex>;
-using cfoa_shm_map_type = boost::unordered::detail::cfoa::table<map_policy<std::string_view, std::size_t>, boost::hash<std::string_view>, std::equal_to<std::string_view>, std::allocator<std::pair<const std::string_view,int>>, std::shared_mutex>;
+#if defined(__AVX2__)
+using cfoa_avx2_map_type = cfoa_group_map_type<boost::unordered::detail::cfoa::group31>;
+#endif
 
-using cuckoo_map_type = libcuckoo::cuckoohash_map<std::string_view, std::size_t, boost::hash<std::string_view>, std::equal_to<std::string_view>, std::allocator<std::pair<const std::string_view,int>>>;
+#if defined(__AVX512BW__)
+using cfoa_avx512_map_type = cfoa_group_map_type<boost::unordered::detail::cfoa::group63>;
+#endif
+
+#if defined(__unix__)
+using shm_segment_type = boost::interprocess::managed_shared_memory;
+using cfoa_ipc_map_type = boost::unordered::detail::cfoa::table<map_policy<std::string_view, std::size_t>, word_hash, std::equal_to<std::string_view>, boost::interprocess::allocator<std::pair<const std::string_view, std::size_t>, shm_segment_type::segment_manager>>;
+#endif
+
+// word counts go through combining_counter; parallel<Map> calls size() only
+// once the counting threads are joined, so that's where pending deltas are
+// flushed
+
+struct cfoa_combining_map_type
+{
+    cfoa_map_type map;
+    combining_counter<cfoa_map_type> counter{ map };
+
+    std::size_t size()
+    {
+        counter.flush();
+        return map.size();
+    }
+};
+
+using cuckoo_map_type = libcuckoo::cuckoohash_map<std::string_view, std::size_t, word_hash, std::equal_to<std::string_view>, std::allocator<std::pair<const std::string_view,int>>>;
 
 struct tbb_hash_compare
 {
     std::size_t hash( std::string_view const& x ) const
     {
-        return boost::hash<std::string_view>()( x );
+        return word_hash()( x );
     }
 
     bool equal( std::string_view const& x, std::string_view const& y ) const
@@ -143,7 +227,7 @@ struct tbb_hash_compare
 
 using tbb_map_type = tbb::concurrent_hash_map<std::string_view, std::size_t, tbb_hash_compare>;
 
-template<class Mutex> using gtl_map_type = gtl::parallel_flat_hash_map<std::string_view, std::size_t, boost::hash<std::string_view>, std::equal_to<std::string_view>, std::allocator<std::pair<const std::string_view, int>>, 9, Mutex>;
+template<class Mutex> using gtl_map_type = gtl::parallel_flat_hash_map<std::string_view, std::size_t, word_hash, std::equal_to<std::string_view>, std::allocator<std::pair<const std::string_view, int>>, 9, Mutex>;
 
 // map operations
 
@@ -169,6 +253,64 @@ inline bool contains_element( cfoa_map_type const& map, std::string_view key )
     return map.find( key, [&]( auto& ){} );
 }
 
+inline void increment_element( cfoa_hashed_map_type& map, std::string_view key )
+{
+    map.try_emplace(
+        []( auto& x, bool ){ ++x.second; },
+        key, 0 );
+}
+
+inline bool contains_element( cfoa_hashed_map_type const& map, std::string_view key )
+{
+    return map.find( key, [&]( auto& ){} );
+}
+
+inline void increment_element( cfoa_ssh_map_type& map, std::string_view key )
+{
+    map.try_emplace(
+        []( auto& x, bool ){ ++x.second; },
+        key, 0 );
+}
+
+inline bool contains_element( cfoa_ssh_map_type const& map, std::string_view key )
+{
+    return map.find( key, [&]( auto& ){} );
+}
+
+inline void increment_element( cfoa_huge_map_type& map, std::string_view key )
+{
+    map.try_emplace(
+        []( auto& x, bool ){ ++x.second; },
+        key, 0 );
+}
+
+inline bool contains_element( cfoa_huge_map_type const& map, std::string_view key )
+{
+    return map.find( key, [&]( auto& ){} );
+}
+
+inline void increment_element( cfoa_combining_map_type& map, std::string_view key )
+{
+    map.counter.add( key );
+}
+
+inline bool contains_element( cfoa_combining_map_type const& map, std::string_view key )
+{
+    return map.map.find( key, [&]( auto& ){} );
+}
+
+inline void increment_elements( cfoa_map_type& map, std::string const* first, std::string const* last )
+{
+    map.try_emplace_bulk(
+        []( auto& x, bool ){ ++x.second; },
+        first, last, 0 );
+}
+
+inline std::size_t contains_elements( cfoa_map_type const& map, std::string_view const* first, std::string_view const* last )
+{
+    return map.find_bulk( first, last, [&]( auto& ){} );
+}
+
 inline void increment_element( cfoa_tbb_map_type& map, std::string_view key )
 {
     map.try_emplace(
@@ -193,6 +335,46 @@ inline bool contains_element( cfoa_shm_map_type const& map, std::string_view key
     return map.find( key, [&]( auto& ){} );
 }
 
+inline void increment_element( cfoa_qrw_map_type& map, std::string_view key )
+{
+    map.try_emplace(
+        []( auto& x, bool ){ ++x.second; },
+        key, 0 );
+}
+
+inline bool contains_element( cfoa_qrw_map_type const& map, std::string_view key )
+{
+    return map.find( key, [&]( auto& ){} );
+}
+
+#if defined(__unix__)
+
+inline void increment_element( cfoa_ipc_map_type& map, std::string_view key )
+{
+    map.try_emplace(
+        []( auto& x, bool ){ ++x.second; },
+        key, 0 );
+}
+
+inline bool contains_element( cfoa_ipc_map_type const& map, std::string_view key )
+{
+    return map.find( key, [&]( auto& ){} );
+}
+
+#endif
+
+template<class Group> inline void increment_element( cfoa_group_map_type<Group>& map, std::string_view key )
+{
+    map.try_emplace(
+        []( auto& x, bool ){ ++x.second; },
+        key, 0 );
+}
+
+template<class Group> inline bool contains_element( cfoa_group_map_type<Group> const& map, std::string_view key )
+{
+    return map.find( key, [&]( auto& ){} );
+}
+
 inline void increment_element( cuckoo_map_type& map, std::string_view key )
 {
     map.uprase_fn(
@@ -330,7 +512,7 @@ template<class Map, class Mutex = null_mutex> struct single_threaded
 
 template<class Mutex> struct ufm_locked
 {
-    alignas(64) boost::unordered_flat_map<std::string_view, std::size_t> map;
+    alignas(64) boost::unordered_flat_map<std::string_view, std::size_t, word_hash> map;
     alignas(64) Mutex mtx;
 
     BOOST_NOINLINE void test_word_count( std::chrono::steady_clock::time_point & t1 )
@@ -414,9 +596,21 @@ template<class Mutex> struct ufm_locked
     }
 };
 
+// picks the shard from a multiplicative remix of the hash; the inner maps
+// take the group position from the high bits of the hash and the reduced
+// hash from its low byte, and don't mix avalanching hashes such as
+// short_string_hash, so a shard taken directly from either end would leave
+// all its keys sharing those bits
+
+inline std::size_t shard_for( std::size_t hash, std::size_t n )
+{
+    std::uint64_t h = static_cast<std::uint64_t>( hash ) * 0x9E3779B97F4A7C15ull;
+    return static_cast<std::size_t>( ( h >> 32 ) * n >> 32 );
+}
+
 template<class Mutex> struct sync_map
 {
-    alignas(64) boost::unordered_flat_map<std::string_view, std::size_t> map;
+    alignas(64) boost::unordered_flat_map<std::string_view, std::size_t, word_hash> map;
     alignas(64) Mutex mtx;
 };
 
@@ -445,8 +639,8 @@ template<class Mutex> struct ufm_sharded
                 {
                     auto const& word = words[ j ];
 
-                    std::size_t hash = boost::hash<std::string_view>()( word );
-                    std::size_t shard = hash % Sh;
+                    std::size_t hash = word_hash()( word );
+                    std::size_t shard = shard_for( hash, Sh );
 
                     std::lock_guard<Mutex> lock( sync[ shard ].mtx );
 
@@ -497,8 +691,8 @@ template<class Mutex> struct ufm_sharded
                     std::string_view w2( words[j] );
                     w2.remove_prefix( 1 );
 
-                    std::size_t hash = boost::hash<std::string_view>()( w2 );
-                    std::size_t shard = hash % Sh;
+                    std::size_t hash = word_hash()( w2 );
+                    std::size_t shard = shard_for( hash, Sh );
 
                     std::lock_guard<Mutex> lock( sync[ shard ].mtx );
 
@@ -534,7 +728,7 @@ struct prehashed
     std::string_view x;
     std::size_t h;
 
-    explicit prehashed( std::string_view x_ ): x( x_ ), h( boost::hash<std::string_view>()( x_ ) ) { }
+    explicit prehashed( std::string_view x_ ): x( x_ ), h( word_hash()( x_ ) ) { }
 
     operator std::string_view () const
     {
@@ -557,8 +751,13 @@ struct prehashed
     }
 };
 
+// the stored hash is as good as word_hash is
+
+template<class H, class = void> struct avalanching_as {};
+template<class H> struct avalanching_as<H, std::void_t<typename H::is_avalanching>> { using is_avalanching = void; };
+
 template<>
-struct boost::hash< prehashed >
+struct boost::hash< prehashed >: avalanching_as<word_hash>
 {
     using is_transparent = void;
 
@@ -569,7 +768,7 @@ struct boost::hash< prehashed >
 
     std::size_t operator()( std::string_view x ) const
     {
-        return boost::hash<std::string_view>()( x );
+        return word_hash()( x );
     }
 };
 
@@ -605,7 +804,7 @@ template<class Mutex> struct ufm_sharded_prehashed
                     std::string_view word = words[ j ];
 
                     prehashed x( word );
-                    std::size_t shard = x.h % Sh;
+                    std::size_t shard = shard_for( x.h, Sh );
 
                     std::lock_guard<Mutex> lock( sync[ shard ].mtx );
 
@@ -657,7 +856,7 @@ template<class Mutex> struct ufm_sharded_prehashed
                     w2.remove_prefix( 1 );
 
                     prehashed x( w2 );
-                    std::size_t shard = x.h % Sh;
+                    std::size_t shard = shard_for( x.h, Sh );
 
                     ::shared_lock<Mutex> lock( sync[ shard ].mtx );
 
@@ -692,7 +891,7 @@ struct ufm_sharded_isolated
 {
     struct
     {
-        alignas(64) boost::unordered_flat_map<std::string_view, std::size_t> map;
+        alignas(64) boost::unordered_flat_map<std::string_view, std::size_t, word_hash> map;
     }
     sync[ Th ];
 
@@ -712,8 +911,8 @@ struct ufm_sharded_isolated
                 {
                     auto const& word = words[ j ];
 
-                    std::size_t hash = boost::hash<std::string_view>()( word );
-                    std::size_t shard = hash % Th;
+                    std::size_t hash = word_hash()( word );
+                    std::size_t shard = shard_for( hash, Th );
 
                     if( shard == i )
                     {
@@ -760,8 +959,8 @@ struct ufm_sharded_isolated
                     std::string_view w2( words[j] );
                     w2.remove_prefix( 1 );
 
-                    std::size_t hash = boost::hash<std::string_view>()( w2 );
-                    std::size_t shard = hash % Th;
+                    std::size_t hash = word_hash()( w2 );
+                    std::size_t shard = shard_for( hash, Th );
 
                     if( shard == i )
                     {
@@ -816,7 +1015,7 @@ struct ufm_sharded_isolated_prehashed
                     std::string_view word = words[ j ];
 
                     prehashed x( word );
-                    std::size_t shard = x.h % Th;
+                    std::size_t shard = shard_for( x.h, Th );
 
                     if( shard == i )
                     {
@@ -864,7 +1063,7 @@ struct ufm_sharded_isolated_prehashed
                     w2.remove_prefix( 1 );
 
                     prehashed x( w2 );
-                    std::size_t shard = x.h % Th;
+                    std::size_t shard = shard_for( x.h, Th );
 
                     if( shard == i )
                     {
@@ -975,6 +1174,540 @@ template<class Map> struct parallel
     }
 };
 
+// before the word count phase, the number of distinct words is estimated
+// with HyperLogLog and the map reserved accordingly, so that it doesn't need
+// to grow; 1/32 is added to the estimate to cover its error (0.8% std. dev.)
+
+template<class Map> struct parallel_reserve: parallel<Map>
+{
+    using parallel<Map>::map;
+
+    BOOST_NOINLINE void test_word_count( std::chrono::steady_clock::time_point & t1 )
+    {
+        std::size_t n = estimate_distinct( words.begin(), words.end(), []( std::string const& w ){
+
+            return word_hash()( w );
+        }, Th );
+
+        map.reserve( n + n / 32 );
+
+        print_time( t1, "Estimate and reserve", n, map.capacity() );
+
+        parallel<Map>::test_word_count( t1 );
+    }
+};
+
+// insertions and lookups are issued in batches through increment_elements
+// and contains_elements
+
+template<class Map> struct parallel_bulk: parallel<Map>
+{
+    using parallel<Map>::map;
+
+    BOOST_NOINLINE void test_word_count( std::chrono::steady_clock::time_point & t1 )
+    {
+        std::atomic<std::size_t> s = 0;
+
+        std::thread th[ Th ];
+
+        std::size_t m = words.size() / Th;
+
+        for( std::size_t i = 0; i < Th; ++i )
+        {
+            th[ i ] = std::thread( [this, i, m, &s]{
+
+                std::size_t start = i * m;
+                std::size_t end = i == Th-1? words.size(): (i + 1) * m;
+
+                increment_elements( map, words.data() + start, words.data() + end );
+
+                s += end - start;
+            });
+        }
+
+        for( std::size_t i = 0; i < Th; ++i )
+        {
+            th[ i ].join();
+        }
+
+        print_time( t1, "Word count", s, map.size() );
+
+        std::cout << std::endl;
+    }
+
+    BOOST_NOINLINE void test_contains( std::chrono::steady_clock::time_point & t1 )
+    {
+        std::atomic<std::size_t> s = 0;
+
+        std::thread th[ Th ];
+
+        std::size_t m = words.size() / Th;
+
+        for( std::size_t i = 0; i < Th; ++i )
+        {
+            th[ i ] = std::thread( [this, i, m, &s]{
+
+                std::size_t s2 = 0;
+
+                std::size_t start = i * m;
+                std::size_t end = i == Th-1? words.size(): (i + 1) * m;
+
+                std::size_t const B = Map::bulk_lookup_size;
+                std::string_view w2[ B ];
+
+                for( std::size_t j = start; j < end; j += B )
+                {
+                    std::size_t n = std::min( B, end - j );
+
+                    for( std::size_t k = 0; k < n; ++k )
+                    {
+                        w2[ k ] = words[ j + k ];
+                        w2[ k ].remove_prefix( 1 );
+                    }
+
+                    s2 += contains_elements( map, w2, w2 + n );
+                }
+
+                s += s2;
+            });
+        }
+
+        for( std::size_t i = 0; i < Th; ++i )
+        {
+            th[ i ].join();
+        }
+
+        print_time( t1, "Contains", s, map.size() );
+
+        std::cout << std::endl;
+    }
+};
+
+// after the contains phase, all the elements are scanned with cvisit_all
+
+template<class Map> struct parallel_visit: parallel<Map>
+{
+    using parallel<Map>::map;
+
+    BOOST_NOINLINE void test_contains( std::chrono::steady_clock::time_point & t1 )
+    {
+        parallel<Map>::test_contains( t1 );
+        test_visit_all( t1 );
+    }
+
+    BOOST_NOINLINE void test_visit_all( std::chrono::steady_clock::time_point & t1 )
+    {
+        // per-thread partial sums, to avoid measuring contention on a single counter
+
+        struct alignas(64) padded_count
+        {
+            std::atomic<std::size_t> n = 0;
+        };
+
+        static padded_count counts[ Th ];
+
+        map.cvisit_all( std::execution::par, []( auto const& x ){
+
+            std::size_t i = std::hash<std::thread::id>()( std::this_thread::get_id() ) % Th;
+            counts[ i ].n.fetch_add( x.second, std::memory_order_relaxed );
+        });
+
+        std::size_t s = 0;
+
+        for( auto& c: counts )
+        {
+            s += c.n.exchange( 0 );
+        }
+
+        print_time( t1, "Visit all", s, map.size() );
+
+        std::cout << std::endl;
+    }
+};
+
+#if defined(BENCHMARK_RACY_CVISIT)
+
+// word counts are incremented while holding only the shared group lock, as
+// try_emplace did before it took the exclusive one; this is a data race
+// (undefined behavior) and only here to measure the cost of exclusive
+// visitation, so it's only built with -DBENCHMARK_RACY_CVISIT. The total of
+// the counts, which falls short of the number of words by the lost
+// increments, is reported after the word count phase
+
+template<class Map> struct parallel_cvisit: parallel<Map>
+{
+    using parallel<Map>::map;
+
+    BOOST_NOINLINE void test_word_count( std::chrono::steady_clock::time_point & t1 )
+    {
+        std::atomic<std::size_t> s = 0;
+
+        std::thread th[ Th ];
+
+        std::size_t m = words.size() / Th;
+
+        for( std::size_t i = 0; i < Th; ++i )
+        {
+            th[ i ] = std::thread( [this, i, m, &s]{
+
+                std::size_t s2 = 0;
+
+                std::size_t start = i * m;
+                std::size_t end = i == Th-1? words.size(): (i + 1) * m;
+
+                for( std::size_t j = start; j < end; ++j )
+                {
+                    map.try_emplace_or_cvisit(
+                        []( auto const& x, bool ){ ++const_cast<std::size_t&>( x.second ); },
+                        std::string_view( words[j] ), 0 );
+
+                    ++s2;
+                }
+
+                s += s2;
+            });
+        }
+
+        for( std::size_t i = 0; i < Th; ++i )
+        {
+            th[ i ].join();
+        }
+
+        print_time( t1, "Word count", s, map.size() );
+
+        std::size_t n = 0;
+
+        map.cvisit_all( [&]( auto const& x ){ n += x.second; } );
+
+        std::cout << "Lost increments: " << s - n << "\n\n";
+    }
+};
+
+#endif
+
+// after the word count phase, the map is rehashed to twice its capacity, first
+// by the calling thread and then (again doubling) by std::execution::par
+
+template<class Map> struct parallel_rehash: parallel<Map>
+{
+    using parallel<Map>::map;
+
+    BOOST_NOINLINE void test_word_count( std::chrono::steady_clock::time_point & t1 )
+    {
+        parallel<Map>::test_word_count( t1 );
+
+        map.rehash( map.capacity() * 2 );
+        print_time( t1, "Rehash", 0, map.size() );
+
+        map.rehash( std::execution::par, map.capacity() * 2 );
+        print_time( t1, "Rehash, parallel", 0, map.size() );
+
+        std::cout << std::endl;
+    }
+};
+
+// after the contains phase, the map is copied and the copy cleared, first
+// sequentially and then with std::execution::par
+
+template<class Map> struct parallel_copy: parallel<Map>
+{
+    using parallel<Map>::map;
+
+    BOOST_NOINLINE void test_contains( std::chrono::steady_clock::time_point & t1 )
+    {
+        parallel<Map>::test_contains( t1 );
+
+        {
+            Map map2( map );
+            print_time( t1, "Copy", 0, map2.size() );
+
+            map2.clear();
+            print_time( t1, "Clear", 0, map2.size() );
+        }
+
+        {
+            Map map2( std::execution::par, map );
+            print_time( t1, "Copy, parallel", 0, map2.size() );
+
+            map2.clear( std::execution::par );
+            print_time( t1, "Clear, parallel", 0, map2.size() );
+        }
+
+        std::cout << std::endl;
+    }
+};
+
+// after the contains phase, all the words but one in 16 are erased in
+// parallel, with the map set to shrink automatically as its load drops
+
+template<class Map> struct parallel_shrink: parallel<Map>
+{
+    using parallel<Map>::map;
+
+    BOOST_NOINLINE void test_contains( std::chrono::steady_clock::time_point & t1 )
+    {
+        parallel<Map>::test_contains( t1 );
+
+        std::size_t capacity = map.capacity();
+
+        map.min_load_factor( 0.2f );
+
+        std::thread th[ Th ];
+
+        std::size_t m = words.size() / Th;
+
+        for( std::size_t i = 0; i < Th; ++i )
+        {
+            th[ i ] = std::thread( [this, i, m]{
+
+                std::size_t start = i * m;
+                std::size_t end = i == Th-1? words.size(): (i + 1) * m;
+
+                for( std::size_t j = start; j < end; ++j )
+                {
+                    if( word_hash()( words[j] ) % 16 ) map.erase( std::string_view( words[j] ) );
+                }
+            });
+        }
+
+        for( std::size_t i = 0; i < Th; ++i )
+        {
+            th[ i ].join();
+        }
+
+        print_time( t1, "Erase", 0, map.size() );
+
+        std::cout << "Capacity: " << capacity << " -> " << map.capacity() << "\n\n";
+    }
+};
+
+// the contains phase additionally reports the dTLB load misses incurred by
+// all lookup threads, as counted by perf_event_open (Linux only; the counter
+// may be unavailable depending on /proc/sys/kernel/perf_event_paranoid)
+
+template<class Map> struct parallel_tlb: parallel<Map>
+{
+    using parallel<Map>::map;
+
+    BOOST_NOINLINE void test_contains( std::chrono::steady_clock::time_point & t1 )
+    {
+#if defined(__linux__)
+
+        perf_event_attr attr = {};
+
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.size = sizeof( attr );
+        attr.config = PERF_COUNT_HW_CACHE_DTLB | ( PERF_COUNT_HW_CACHE_OP_READ << 8 ) | ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 );
+        attr.disabled = 1;
+        attr.inherit = 1; // count the lookup threads created below
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        int fd = static_cast<int>( syscall( SYS_perf_event_open, &attr, 0, -1, -1, 0 ) );
+
+        if( fd != -1 )
+        {
+            ioctl( fd, PERF_EVENT_IOC_RESET, 0 );
+            ioctl( fd, PERF_EVENT_IOC_ENABLE, 0 );
+        }
+
+        parallel<Map>::test_contains( t1 );
+
+        if( fd != -1 )
+        {
+            ioctl( fd, PERF_EVENT_IOC_DISABLE, 0 );
+
+            std::uint64_t misses = 0;
+
+            if( read( fd, &misses, sizeof( misses ) ) == sizeof( misses ) )
+            {
+                std::cout << "dTLB load misses: " << misses << " (" << double( misses ) / words.size() << " per lookup)\n\n";
+            }
+
+            close( fd );
+        }
+        else
+        {
+            std::cout << "dTLB load misses: unavailable\n\n";
+        }
+
+#else
+
+        parallel<Map>::test_contains( t1 );
+
+#endif
+    }
+};
+
+#if defined(__unix__)
+
+// Th worker processes instead of threads, sharing a map placed in a shared
+// memory segment; each worker maps the segment anew, generally at a different
+// address. Workers are forked, so std::string_view keys into words are valid
+// in all of them
+
+template<class Map> struct multiprocess
+{
+    static constexpr char const* segment_name = "cfoa_multiprocess";
+
+    shm_segment_type segment;
+    Map* map;
+    std::atomic<std::size_t>* s;
+
+    multiprocess()
+    {
+        boost::interprocess::shared_memory_object::remove( segment_name );
+        segment = shm_segment_type( boost::interprocess::create_only, segment_name, 1u << 30 );
+
+        // Map is overaligned, which segment.construct doesn't honor
+
+        void* p = segment.allocate_aligned( sizeof( Map ), alignof( Map ) );
+        map = new( p ) Map( 354000, {}, {}, typename Map::allocator_type( segment.get_segment_manager() ) );
+
+        s = segment.construct<std::atomic<std::size_t>>( boost::interprocess::anonymous_instance )( 0 );
+    }
+
+    ~multiprocess()
+    {
+        map->~Map();
+        segment.deallocate( map );
+        segment.destroy_ptr( s );
+        boost::interprocess::shared_memory_object::remove( segment_name );
+    }
+
+    template<class F> void run_workers( F f )
+    {
+        *s = 0;
+
+        auto hmap = segment.get_handle_from_address( map );
+        auto hs = segment.get_handle_from_address( s );
+
+        pid_t pid[ Th ];
+
+        for( std::size_t i = 0; i < Th; ++i )
+        {
+            pid[ i ] = fork();
+
+            if( pid[ i ] == 0 )
+            {
+                shm_segment_type segment2( boost::interprocess::open_only, segment_name );
+
+                auto& map2 = *static_cast<Map*>( segment2.get_address_from_handle( hmap ) );
+                auto& s2 = *static_cast<std::atomic<std::size_t>*>( segment2.get_address_from_handle( hs ) );
+
+                std::size_t m = words.size() / Th;
+
+                std::size_t start = i * m;
+                std::size_t end = i == Th-1? words.size(): (i + 1) * m;
+
+                s2 += f( map2, start, end );
+
+                _exit( 0 );
+            }
+        }
+
+        for( std::size_t i = 0; i < Th; ++i )
+        {
+            waitpid( pid[ i ], nullptr, 0 );
+        }
+    }
+
+    BOOST_NOINLINE void test_word_count( std::chrono::steady_clock::time_point & t1 )
+    {
+        run_workers( []( Map& map, std::size_t start, std::size_t end ){
+
+            std::size_t s2 = 0;
+
+            for( std::size_t j = start; j < end; ++j )
+            {
+                increment_element( map, words[j] );
+                ++s2;
+            }
+
+            return s2;
+        });
+
+        print_time( t1, "Word count", *s, map->size() );
+
+        std::cout << std::endl;
+    }
+
+    BOOST_NOINLINE void test_contains( std::chrono::steady_clock::time_point & t1 )
+    {
+        run_workers( []( Map& map, std::size_t start, std::size_t end ){
+
+            std::size_t s2 = 0;
+
+            for( std::size_t j = start; j < end; ++j )
+            {
+                std::string_view w2( words[j] );
+                w2.remove_prefix( 1 );
+
+                s2 += contains_element( map, w2 );
+            }
+
+            return s2;
+        });
+
+        print_time( t1, "Contains", *s, map->size() );
+
+        std::cout << std::endl;
+    }
+};
+
+#endif
+
+// after the word count phase, the map is saved to an image and reloaded
+// from it, as a warm restart would do; keys are stored in the image arena
+
+struct string_view_key_relocator
+{
+    template<class E> void save( E& e, std::string& arena, std::uintptr_t arena_address ) const
+    {
+        std::string_view k( e.first );
+        auto v = e.second;
+
+        std::uintptr_t p = arena_address + arena.size();
+        arena.append( k );
+
+        new( &e ) E( std::string_view( reinterpret_cast<char const*>( p ), k.size() ), v );
+    }
+
+    template<class E> void relocate( E& e, std::uintptr_t from, std::uintptr_t to ) const
+    {
+        std::string_view k( e.first );
+        auto v = e.second;
+
+        std::uintptr_t p = reinterpret_cast<std::uintptr_t>( k.data() ) - from + to;
+
+        new( &e ) E( std::string_view( reinterpret_cast<char const*>( p ), k.size() ), v );
+    }
+};
+
+template<class Map> struct parallel_image: parallel<Map>
+{
+    using parallel<Map>::map;
+
+    BOOST_NOINLINE void test_word_count( std::chrono::steady_clock::time_point & t1 )
+    {
+        parallel<Map>::test_word_count( t1 );
+
+        char const* fn = "cfoa.img";
+
+        map.save_image( fn, string_view_key_relocator() );
+        print_time( t1, "Save image", 0, map.size() );
+
+        map.load_image( fn, string_view_key_relocator() );
+        print_time( t1, "Load image", 0, map.size() );
+
+        // the loaded map is a private mapping, which outlives the file
+
+        std::remove( fn );
+
+        std::cout << std::endl;
+    }
+};
+
 //
 
 struct record
@@ -985,6 +1718,46 @@ struct record
 
 static std::vector<record> times;
 
+// table statistics, available for concurrent foa maps when compiled with
+// -DBOOST_UNORDERED_CFOA_ENABLE_STATS
+
+template<class T> auto print_stats( T const& t, int ) -> decltype( t.map.get_stats(), void() )
+{
+    auto stats = t.map.get_stats();
+
+    auto print_histogram = []( char const* label, auto const& h )
+    {
+        std::size_t n = 0, m = 0;
+
+        for( std::size_t i = 0; i < std::size( h ); ++i )
+        {
+            n += h[ i ];
+            m += h[ i ] * ( i + 1 );
+        }
+
+        std::cout << label << ": " << n << " probes, average length " << ( n? double( m ) / n: 0.0 ) << " (";
+
+        for( std::size_t i = 0; i < std::size( h ); ++i )
+        {
+            std::cout << ( i? " ": "" ) << h[ i ];
+        }
+
+        std::cout << ")\n";
+    };
+
+    print_histogram( "Lookup probe lengths", stats.lookup_probe_lengths );
+    print_histogram( "Insertion probe lengths", stats.insertion_probe_lengths );
+
+    std::cout << "False matches: " << stats.false_matches << "\n";
+    std::cout << "Startovers: " << stats.startovers << "\n";
+    std::cout << "Overflow bits set: " << stats.overflow_bits_set << "\n";
+    std::cout << "Rehashes: " << stats.rehashes << ", " << stats.rehash_time / 1ms << " ms\n\n";
+}
+
+template<class T> void print_stats( T const&, long )
+{
+}
+
 template<class Map> BOOST_NOINLINE void test( char const* label )
 {
     std::cout << label << ":\n\n";
@@ -1000,6 +1773,9 @@ template<class Map> BOOST_NOINLINE void test( char const* label )
     map.test_contains( t1 );
 
     auto tN = std::chrono::steady_clock::now();
+
+    print_stats( map, 0 );
+
     std::cout << "Total: " << ( tN - t0 ) / 1ms << " ms\n\n";
 
     rec.time_ = ( tN - t0 ) / 1ms;
@@ -1019,6 +1795,7 @@ int main()
     test<single_threaded<cfoa_map_type>>( "concurrent_foa, single threaded" );
     test<single_threaded<cfoa_tbb_map_type>>( "concurrent_foa, tbb::spin_rw_mutex, single threaded" );
     test<single_threaded<cfoa_shm_map_type>>( "concurrent_foa, std::shared_mutex, single threaded" );
+    test<single_threaded<cfoa_swar_map_type>>( "concurrent_foa, SWAR group15, single threaded" );
     // test<single_threaded<cuckoo_map_type>>( "libcuckoo::cuckoohash_map, single threaded" );
     test<single_threaded<tbb_map_type>>( "tbb::concurrent_hash_map, single threaded" );
     // test<single_threaded<gtl_map_type<rw_spinlock>>>( "gtl::parallel_flat_hash_map<rw_spinlock>, single threaded" );
@@ -1026,6 +1803,7 @@ int main()
     // test<ufm_locked<std::mutex>>( "boost::unordered_flat_map, locked<mutex>" );
     // test<ufm_locked<std::shared_mutex>>( "boost::unordered_flat_map, locked<shared_mutex>" );
     // test<ufm_locked<rw_spinlock>>( "boost::unordered_flat_map, locked<rw_spinlock>" );
+    // test<ufm_locked<queued_rw_lock>>( "boost::unordered_flat_map, locked<queued_rw_lock>" );
 
     // test<ufm_sharded<std::mutex>>( "boost::unordered_flat_map, sharded<mutex>" );
     test<ufm_sharded_prehashed<std::mutex>>( "boost::unordered_flat_map, sharded_prehashed<mutex>" );
@@ -1033,18 +1811,50 @@ int main()
     test<ufm_sharded_prehashed<std::shared_mutex>>( "boost::unordered_flat_map, sharded_prehashed<shared_mutex>" );
     // test<ufm_sharded<rw_spinlock>>( "boost::unordered_flat_map, sharded<rw_spinlock>" );
     test<ufm_sharded_prehashed<rw_spinlock>>( "boost::unordered_flat_map, sharded_prehashed<rw_spinlock>" );
+    // test<ufm_sharded<queued_rw_lock>>( "boost::unordered_flat_map, sharded<queued_rw_lock>" );
+    test<ufm_sharded_prehashed<queued_rw_lock>>( "boost::unordered_flat_map, sharded_prehashed<queued_rw_lock>" );
 
     // test<ufm_sharded_isolated>( "boost::unordered_flat_map, sharded isolated" );
     test<ufm_sharded_isolated_prehashed>( "boost::unordered_flat_map, sharded isolated, prehashed" );
 
     test<parallel<cfoa_map_type>>( "concurrent foa" );
+    test<parallel_bulk<cfoa_map_type>>( "concurrent foa, bulk" );
+    test<parallel_reserve<cfoa_map_type>>( "concurrent foa, reserve by estimate" );
+    test<parallel_visit<cfoa_map_type>>( "concurrent foa, visit_all" );
+#if defined(BENCHMARK_RACY_CVISIT)
+    test<parallel_cvisit<cfoa_map_type>>( "concurrent foa, shared-locked increments (racy)" );
+#endif
+    test<parallel_image<cfoa_map_type>>( "concurrent foa, image" );
+    test<parallel_rehash<cfoa_map_type>>( "concurrent foa, parallel rehash" );
+    test<parallel_copy<cfoa_map_type>>( "concurrent foa, parallel copy and clear" );
+    test<parallel_shrink<cfoa_map_type>>( "concurrent foa, erase with automatic shrink" );
+#if defined(__unix__)
+    test<multiprocess<cfoa_ipc_map_type>>( "concurrent foa, shared memory, processes" );
+#endif
+    test<parallel<cfoa_hashed_map_type>>( "concurrent foa, stored hash" );
+    test<parallel<cfoa_ssh_map_type>>( "concurrent foa, short_string_hash" );
+    test<parallel<cfoa_combining_map_type>>( "concurrent foa, combining_counter" );
+    test<parallel_tlb<cfoa_map_type>>( "concurrent foa, dTLB misses" );
+    test<parallel_tlb<cfoa_huge_map_type>>( "concurrent foa, huge pages, dTLB misses" );
     test<parallel<cfoa_tbb_map_type>>( "concurrent foa, tbb::spin_rw_mutex" );
     test<parallel<cfoa_shm_map_type>>( "concurrent foa, std::shared_mutex" );
+    test<parallel<cfoa_qrw_map_type>>( "concurrent foa, queued_rw_lock" );
+    test<parallel<cfoa_swar_map_type>>( "concurrent foa, SWAR group15" );
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+    test<parallel<cfoa_locked_map_type>>( "concurrent foa, locked insertion" );
+#endif
+#if defined(__AVX2__)
+    test<parallel<cfoa_avx2_map_type>>( "concurrent foa, AVX2 group31" );
+#endif
+#if defined(__AVX512BW__)
+    test<parallel<cfoa_avx512_map_type>>( "concurrent foa, AVX-512 group63" );
+#endif
     // test<parallel<cuckoo_map_type>>( "libcuckoo::cuckoohash_map" );
     test<parallel<tbb_map_type>>( "tbb::concurrent_hash_map" );
     test<parallel<gtl_map_type<std::mutex>>>( "gtl::parallel_flat_hash_map<std::mutex>" );
     test<parallel<gtl_map_type<std::shared_mutex>>>( "gtl::parallel_flat_hash_map<std::shared_mutex>" );
     test<parallel<gtl_map_type<rw_spinlock>>>( "gtl::parallel_flat_hash_map<rw_spinlock>" );
+    test<parallel<gtl_map_type<queued_rw_lock>>>( "gtl::parallel_flat_hash_map<queued_rw_lock>" );
 
     std::cout << "---\n\n";
 
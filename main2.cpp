@@ -7,6 +7,7 @@
 #define _SILENCE_CXX20_CISO646_REMOVED_WARNING
 
 #include <boost/unordered/concurrent_flat_map.hpp>
+#include <boost/unordered/unordered_flat_map.hpp>
 #include <boost/regex.hpp>
 #include <vector>
 #include <memory>
@@ -21,7 +22,11 @@
 #include <thread>
 #include <atomic>
 #include <shared_mutex>
+#include <algorithm>
 #include "oneapi/tbb/concurrent_hash_map.h"
+#include "cfoa.hpp"
+#include "rw_spinlock.hpp"
+#include "queued_rw_lock.hpp"
 
 #if !defined(NUM_THREADS)
 # define NUM_THREADS 48
@@ -60,6 +65,70 @@ static void init_words()
 
 //
 
+// type policy for concurrent foa maps with std::atomic<T> mapped values,
+// which declares them atomically updatable so that visitation only
+// shared-locks the element's group; values are loaded when elements are
+// moved or copied
+
+template<typename Key,typename T>
+struct atomic_map_policy
+{
+  using key_type=Key;
+  using raw_key_type=typename std::remove_const<Key>::type;
+
+  using init_type=std::pair<raw_key_type,T>;
+  using moved_type=std::pair<raw_key_type&&,T>;
+  using value_type=std::pair<const Key,std::atomic<T>>;
+  using element_type=value_type;
+
+  using atomically_updatable=std::true_type;
+
+  static value_type& value_from(element_type& x)
+  {
+    return x;
+  }
+
+  template <class K,class V>
+  static const raw_key_type& extract(const std::pair<K,V>& kv)
+  {
+    return kv.first;
+  }
+
+  static moved_type move(value_type& x)
+  {
+    return{
+      std::move(const_cast<raw_key_type&>(x.first)),
+      x.second.load(std::memory_order_relaxed)
+    };
+  }
+
+  template<typename Allocator,typename... Args>
+  static void construct(Allocator& al,element_type* p,Args&&... args)
+  {
+    boost::allocator_traits<Allocator>::
+      construct(al,p,std::forward<Args>(args)...);
+  }
+
+  template<typename Allocator>
+  static void construct(Allocator& al,element_type* p,const value_type& x)
+  {
+    boost::allocator_traits<Allocator>::
+      construct(al,p,x.first,x.second.load(std::memory_order_relaxed));
+  }
+
+  template<typename Allocator>
+  static void construct(Allocator& al,element_type* p,value_type& x)
+  {
+    construct(al,p,const_cast<const value_type&>(x));
+  }
+
+  template<typename Allocator>
+  static void destroy(Allocator& al,element_type* p)noexcept
+  {
+    boost::allocator_traits<Allocator>::destroy(al,p);
+  }
+};
+
 // map types
 
 using cfm_map_type = boost::concurrent_flat_map<std::string_view, std::size_t>;
@@ -79,6 +148,24 @@ struct tbb_hash_compare
 
 using tbb_map_type = tbb::concurrent_hash_map<std::string_view, std::size_t, tbb_hash_compare>;
 
+template<class Mutex> using cfoa_atomic_mutex_map_type = boost::unordered::detail::cfoa::table<atomic_map_policy<std::string_view, std::size_t>, boost::hash<std::string_view>, std::equal_to<std::string_view>, std::allocator<std::pair<const std::string_view, std::atomic<std::size_t>>>, Mutex>;
+
+using cfoa_atomic_map_type = cfoa_atomic_mutex_map_type<rw_spinlock>;
+
+// a single lock around boost::unordered_flat_map, where all threads contend
+// for the same Mutex
+
+template<class Mutex> struct ufm_locked
+{
+    alignas(64) boost::unordered_flat_map<std::string_view, std::size_t> map;
+    alignas(64) Mutex mtx;
+
+    std::size_t size() const
+    {
+        return map.size();
+    }
+};
+
 // map operations
 
 inline void increment_element( cfm_map_type& map, std::string_view key )
@@ -104,6 +191,26 @@ inline bool contains_element( tbb_map_type const& map, std::string_view key )
     return map.count( key ) != 0;
 }
 
+// increments of existing words only take the group's shared lock
+
+template<class Mutex> inline void increment_element( cfoa_atomic_mutex_map_type<Mutex>& map, std::string_view key )
+{
+    map.try_emplace_or_visit(
+        []( auto& x, bool ){ x.second.fetch_add( 1, std::memory_order_relaxed ); },
+        key, 0 );
+}
+
+template<class Mutex> inline bool contains_element( cfoa_atomic_mutex_map_type<Mutex> const& map, std::string_view key )
+{
+    return map.find( key, []( auto const& ){} );
+}
+
+template<class Mutex> inline void increment_element( ufm_locked<Mutex>& map, std::string_view key )
+{
+    std::lock_guard<Mutex> lock( map.mtx );
+    ++map.map[ key ];
+}
+
 //
 
 template<class Map> BOOST_NOINLINE void test_word_count( Map& map, std::size_t Th )
@@ -146,14 +253,100 @@ template<class Map> BOOST_NOINLINE void test( std::size_t Th )
     test_word_count( map, Th );
 }
 
+// with more threads than cores, lock holders get preempted, and the
+// waiters' wake-up latency dominates the tail of the operation latencies
+
+template<class Map> BOOST_NOINLINE void test_latency( std::size_t Th, char const* label )
+{
+    Map map;
+
+    // sample every 64th operation, to keep the timing overhead down
+
+    std::size_t const sample_rate = 64;
+
+    std::vector<std::thread> th( Th );
+    std::vector<std::vector<std::chrono::steady_clock::duration>> lat( Th );
+
+    std::size_t m = words.size() / Th;
+
+    auto t1 = std::chrono::steady_clock::now();
+
+    for( std::size_t i = 0; i < Th; ++i )
+    {
+        th[ i ] = std::thread( [&map, &lat, Th, i, m]{
+
+            std::size_t start = i * m;
+            std::size_t end = i == Th-1? words.size(): (i + 1) * m;
+
+            auto& v = lat[ i ];
+            v.reserve( ( end - start ) / sample_rate + 1 );
+
+            for( std::size_t j = start; j < end; ++j )
+            {
+                if( j % sample_rate == 0 )
+                {
+                    auto t3 = std::chrono::steady_clock::now();
+                    increment_element( map, words[j] );
+                    auto t4 = std::chrono::steady_clock::now();
+
+                    v.push_back( t4 - t3 );
+                }
+                else
+                {
+                    increment_element( map, words[j] );
+                }
+            }
+        });
+    }
+
+    for( std::size_t i = 0; i < Th; ++i )
+    {
+        th[ i ].join();
+    }
+
+    auto t2 = std::chrono::steady_clock::now();
+
+    std::vector<std::chrono::steady_clock::duration> v;
+
+    for( auto const& x: lat )
+    {
+        v.insert( v.end(), x.begin(), x.end() );
+    }
+
+    std::sort( v.begin(), v.end() );
+
+    auto pct = [&]( double p ){ return std::chrono::duration_cast<std::chrono::nanoseconds>( v[ static_cast<std::size_t>( p * ( v.size() - 1 ) ) ] ).count(); };
+
+    std::cout << label << ";" << ( t2 - t1 ) / 1ms << ";" << map.size() << ";" << pct( 0.5 ) << ";" << pct( 0.99 ) << ";" << pct( 0.999 ) << ";" << pct( 1.0 ) << std::endl;
+}
+
 //
 
 int main()
 {
     init_words();
 
+#if defined(OVERSUBSCRIBE)
+
+    // -DOVERSUBSCRIBE=k runs k threads per hardware thread and reports
+    // the latency percentiles (in ns) of the sampled increments
+
+    std::size_t Th = OVERSUBSCRIBE * (std::max)( std::thread::hardware_concurrency(), 1u );
+
+    std::cout << "#threads=" << Th << "\n\n";
+    std::cout << "map;time;size;p50;p99;p99.9;max" << std::endl;
+
+    test_latency<ufm_locked<rw_spinlock>>( Th, "locked<rw_spinlock>" );
+#if defined(__linux__)
+    test_latency<ufm_locked<parking_rw_spinlock>>( Th, "locked<parking_rw_spinlock>" );
+#endif
+    test_latency<ufm_locked<queued_rw_lock>>( Th, "locked<queued_rw_lock>" );
+    test_latency<cfoa_atomic_mutex_map_type<rw_spinlock>>( Th, "concurrent foa, atomic values" );
+
+#else
+
     std::cout << "NUM_THREADS=" << NUM_THREADS << "\n\n";
-    std::cout << "#threads;boost::concurrent_hash_map time;boost::concurrent_hash_map size;tbb::concurrent_hash_map time;tbb::concurrent_hash_map size" << std::endl;
+    std::cout << "#threads;boost::concurrent_hash_map time;boost::concurrent_hash_map size;tbb::concurrent_hash_map time;tbb::concurrent_hash_map size;concurrent foa, atomic values time;concurrent foa, atomic values size;concurrent foa, atomic values, queued_rw_lock time;concurrent foa, atomic values, queued_rw_lock size;locked<rw_spinlock> time;locked<rw_spinlock> size;locked<queued_rw_lock> time;locked<queued_rw_lock> size" << std::endl;
 
     for( std::size_t Th = 1; Th <= NUM_THREADS; ++Th)
     {
@@ -161,7 +354,13 @@ int main()
 
         test<cfm_map_type>( Th );
         test<tbb_map_type>( Th );
+        test<cfoa_atomic_map_type>( Th );
+        test<cfoa_atomic_mutex_map_type<queued_rw_lock>>( Th );
+        test<ufm_locked<rw_spinlock>>( Th );
+        test<ufm_locked<queued_rw_lock>>( Th );
 
         std::cout << std::endl;
     }
+
+#endif
 }
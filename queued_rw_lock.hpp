@@ -0,0 +1,190 @@
+#ifndef QUEUED_RW_LOCK_HPP_INCLUDED
+#define QUEUED_RW_LOCK_HPP_INCLUDED
+
+// Copyright 2026 agent
+// Distributed under the Boost Software License, Version 1.0.
+// https://www.boost.org/LICENSE_1_0.txt
+
+#include <boost/smart_ptr/detail/sp_thread_pause.hpp>
+#include <boost/smart_ptr/detail/sp_thread_sleep.hpp>
+#include <boost/config.hpp>
+#include <atomic>
+#include <cstdint>
+
+// A reader-writer lock that scales to many contending threads by queueing
+// them, along the lines of the Linux kernel's qrwlock.
+//
+// Uncontended lock and lock_shared are a single atomic operation on state_,
+// as in rw_spinlock. A thread that can't take the lock right away enqueues
+// itself in an MCS queue, spinning on a node of its own (allocated on its
+// stack, as it's only needed until the thread leaves the slow path); only
+// the thread at the head of the queue spins on state_. Waiters are served
+// in FIFO order, and a writer at the head of the queue sets the writer
+// waiting bit, which makes incoming readers queue up behind it, so writers
+// aren't starved.
+//
+// Queue nodes are linked by address, so unlike rw_spinlock, a
+// queued_rw_lock can't be shared between processes.
+
+class queued_rw_lock
+{
+private:
+
+    // bit 31: locked exclusive
+    // bit 30: writer waiting
+    // bit 29..: reader lock count
+
+    static constexpr std::uint32_t locked_exclusive = 0x8000'0000;
+    static constexpr std::uint32_t writer_waiting = 0x4000'0000;
+    static constexpr std::uint32_t writer_mask = locked_exclusive | writer_waiting;
+
+    std::atomic<std::uint32_t> state_ = {};
+
+    struct alignas(64) node
+    {
+        std::atomic<node*> next = nullptr;
+        std::atomic<bool> waiting = true;
+    };
+
+    std::atomic<node*> tail_ = {};
+
+private:
+
+    // number of times to spin before sleeping
+    static constexpr int spin_count = 24576;
+
+    template<class F> static void spin_until( F f ) noexcept
+    {
+        for( ;; )
+        {
+            for( int k = 0; k < spin_count; ++k )
+            {
+                if( f() ) return;
+                boost::detail::sp_thread_pause();
+            }
+
+            boost::detail::sp_thread_sleep();
+        }
+    }
+
+    void enqueue( node& n ) noexcept
+    {
+        node* prev = tail_.exchange( &n, std::memory_order_acq_rel );
+
+        if( prev != nullptr )
+        {
+            prev->next.store( &n, std::memory_order_release );
+            spin_until( [&]{ return !n.waiting.load( std::memory_order_acquire ); } );
+        }
+    }
+
+    void dequeue( node& n ) noexcept
+    {
+        node* next = n.next.load( std::memory_order_acquire );
+
+        if( next == nullptr )
+        {
+            node* expected = &n;
+            if( tail_.compare_exchange_strong( expected, nullptr, std::memory_order_release, std::memory_order_relaxed ) ) return;
+
+            // a successor is linking itself in
+
+            spin_until( [&]{ return ( next = n.next.load( std::memory_order_acquire ) ) != nullptr; } );
+        }
+
+        next->waiting.store( false, std::memory_order_release );
+    }
+
+    BOOST_NOINLINE void lock_shared_slow() noexcept
+    {
+        node n;
+        enqueue( n );
+
+        // at the head of the queue; no writer can be waiting, as it would
+        // be ahead of us, but one may hold the lock
+
+        state_.fetch_add( 1, std::memory_order_relaxed );
+        spin_until( [&]{ return !( state_.load( std::memory_order_acquire ) & locked_exclusive ); } );
+
+        dequeue( n );
+    }
+
+    BOOST_NOINLINE void lock_slow() noexcept
+    {
+        node n;
+        enqueue( n );
+
+        // at the head of the queue; keep new readers out and wait for
+        // the current ones to leave
+
+        state_.fetch_or( writer_waiting, std::memory_order_relaxed );
+
+        spin_until( [&]{
+
+            std::uint32_t st = writer_waiting;
+            return state_.compare_exchange_weak( st, locked_exclusive, std::memory_order_acquire, std::memory_order_relaxed );
+        });
+
+        dequeue( n );
+    }
+
+public:
+
+    queued_rw_lock() = default;
+
+    queued_rw_lock( queued_rw_lock const& ) = delete;
+    queued_rw_lock& operator=( queued_rw_lock const& ) = delete;
+
+    bool try_lock_shared() noexcept
+    {
+        std::uint32_t st = state_.load( std::memory_order_relaxed );
+
+        if( st & writer_mask )
+        {
+            return false;
+        }
+
+        return state_.compare_exchange_strong( st, st + 1, std::memory_order_acquire, std::memory_order_relaxed );
+    }
+
+    void lock_shared() noexcept
+    {
+        std::uint32_t st = state_.fetch_add( 1, std::memory_order_acquire );
+
+        if( ( st & writer_mask ) == 0 ) return;
+
+        // a writer holds the lock or is waiting for it, back out and queue
+
+        state_.fetch_sub( 1, std::memory_order_relaxed );
+        lock_shared_slow();
+    }
+
+    void unlock_shared() noexcept
+    {
+        // pre: locked shared
+        state_.fetch_sub( 1, std::memory_order_release );
+    }
+
+    bool try_lock() noexcept
+    {
+        std::uint32_t st = 0;
+        return state_.compare_exchange_strong( st, locked_exclusive, std::memory_order_acquire, std::memory_order_relaxed );
+    }
+
+    void lock() noexcept
+    {
+        if( !try_lock() ) lock_slow();
+    }
+
+    void unlock() noexcept
+    {
+        // pre: locked exclusive
+        //
+        // queued readers may have already added themselves to the count,
+        // so only the exclusive bit is cleared
+
+        state_.fetch_sub( locked_exclusive, std::memory_order_release );
+    }
+};
+
+#endif // QUEUED_RW_LOCK_HPP_INCLUDED
@@ -10,28 +10,117 @@
 #include <atomic>
 #include <cstdint>
 
-class rw_spinlock
+#if defined(__linux__)
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// When spinning fails, basic_rw_spinlock<false> sleeps for a while and
+// polls again, and basic_rw_spinlock<true> parks the thread on a futex
+// on state_ (Linux only) until an unlock wakes it. Parked threads set the
+// waiters bit, so that unlocks only make the wake-up system call when there
+// is someone to wake.
+//
+// Parking isn't free when uncontended: the exclusive unlock has to check
+// for waiters atomically with releasing the lock, which makes it an atomic
+// exchange (a locked RMW) instead of a plain store. rw_spinlock, which is
+// also cfoa's group lock, therefore polls, and parking is opt-in via
+// parking_rw_spinlock, for heavily oversubscribed workloads.
+
+template<bool Park> class basic_rw_spinlock
 {
 private:
 
     // bit 31: locked exclusive
     // bit 30: writer pending
-    // bit 29..: reader lock count
+    // bit 29: waiters parked
+    // bit 28..: reader lock count
+
+    static constexpr std::uint32_t locked_exclusive = 0x8000'0000;
+    static constexpr std::uint32_t writer_pending = 0x4000'0000;
+    static constexpr std::uint32_t waiters = 0x2000'0000;
+    static constexpr std::uint32_t reader_mask = 0x1FFF'FFFF;
 
     std::atomic<std::uint32_t> state_ = {};
 
+    // lock-free atomics are address-free, so a rw_spinlock placed in shared
+    // memory works across processes; so do futexes, as long as they aren't
+    // process private
+
+    static_assert( std::atomic<std::uint32_t>::is_always_lock_free, "rw_spinlock requires lock-free 32-bit atomics" );
+
+#if defined(__linux__)
+
+    static_assert( sizeof( std::atomic<std::uint32_t> ) == sizeof( std::uint32_t ), "futex requires a plain 32-bit word" );
+
+#else
+
+    static_assert( !Park, "parking requires futex support" );
+
+#endif
+
 private:
 
     // number of times to spin before sleeping
     static constexpr int spin_count = 24576;
 
+    // blocks the calling thread, as long as unavailable( state_ ); may
+    // return spuriously
+
+    template<class F> void wait( F unavailable ) noexcept
+    {
+        if constexpr( Park )
+        {
+#if defined(__linux__)
+
+            std::uint32_t st = state_.load( std::memory_order_relaxed );
+
+            for( ;; )
+            {
+                if( !unavailable( st ) ) return;
+
+                if( st & waiters ) break;
+
+                if( state_.compare_exchange_weak( st, st | waiters, std::memory_order_relaxed, std::memory_order_relaxed ) )
+                {
+                    st |= waiters;
+                    break;
+                }
+            }
+
+            // returns immediately if state_ != st, so a wake-up by an
+            // unlock after the waiters bit was set can't be missed
+
+            ::syscall( SYS_futex, &state_, FUTEX_WAIT, st, nullptr, nullptr, 0 );
+
+#endif
+        }
+        else
+        {
+            (void)unavailable;
+            boost::detail::sp_thread_sleep();
+        }
+    }
+
+    void wake_waiters() noexcept
+    {
+#if defined(__linux__)
+
+        state_.fetch_and( ~waiters, std::memory_order_relaxed );
+        ::syscall( SYS_futex, &state_, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0 );
+
+#endif
+    }
+
 public:
 
     bool try_lock_shared() noexcept
     {
         std::uint32_t st = state_.load( std::memory_order_relaxed );
 
-        if( st >= 0x3FFF'FFFF )
+        if( ( st & ~waiters ) >= reader_mask )
         {
             // either bit 31 set, bit 30 set, or reader count is max
             return false;
@@ -49,7 +138,7 @@ public:
             {
                 std::uint32_t st = state_.load( std::memory_order_relaxed );
 
-                if( st < 0x3FFF'FFFF )
+                if( ( st & ~waiters ) < reader_mask )
                 {
                     std::uint32_t newst = st + 1;
                     if( state_.compare_exchange_weak( st, newst, std::memory_order_acquire, std::memory_order_relaxed ) ) return;
@@ -58,7 +147,7 @@ public:
                 boost::detail::sp_thread_pause();
             }
 
-            boost::detail::sp_thread_sleep();
+            wait( []( std::uint32_t st ){ return ( st & ~waiters ) >= reader_mask; } );
         }
     }
 
@@ -66,29 +155,38 @@ public:
     {
         // pre: locked shared, not locked exclusive
 
-        state_.fetch_sub( 1, std::memory_order_release );
+        std::uint32_t st = state_.fetch_sub( 1, std::memory_order_release );
 
         // if the writer pending bit is set, there's a writer waiting
         // let it acquire the lock; it will clear the bit on unlock
+
+        if( Park && ( st & waiters ) && ( st & reader_mask ) == 1 )
+        {
+            // last reader out, wake the parked writers (and the readers
+            // that were held back by the writer pending bit)
+            wake_waiters();
+        }
     }
 
     bool try_lock() noexcept
     {
         std::uint32_t st = state_.load( std::memory_order_relaxed );
 
-        if( st & 0x8000'0000 )
+        if( st & locked_exclusive )
         {
             // locked exclusive
             return false;
         }
 
-        if( st & 0x3FFF'FFFF )
+        if( st & reader_mask )
         {
             // locked shared
             return false;
         }
 
-        std::uint32_t newst = 0x8000'0000;
+        // the waiters bit is kept, so that unlock wakes them
+
+        std::uint32_t newst = locked_exclusive | ( st & waiters );
         return state_.compare_exchange_strong( st, newst, std::memory_order_acquire, std::memory_order_relaxed );
     }
 
@@ -100,18 +198,18 @@ public:
             {
                 std::uint32_t st = state_.load( std::memory_order_relaxed );
 
-                if( st & 0x8000'0000 )
+                if( st & locked_exclusive )
                 {
                     // locked exclusive, spin
                 }
-                else if( ( st & 0x3FFF'FFFF ) == 0 )
+                else if( ( st & reader_mask ) == 0 )
                 {
                     // not locked exclusive, not locked shared, try to lock
 
-                    std::uint32_t newst = 0x8000'0000;
+                    std::uint32_t newst = locked_exclusive | ( st & waiters );
                     if( state_.compare_exchange_weak( st, newst, std::memory_order_acquire, std::memory_order_relaxed ) ) return;
                 }
-                else if( st & 0x4000'000 )
+                else if( st & writer_pending )
                 {
                     // writer pending bit already set, nothing to do
                 }
@@ -119,7 +217,7 @@ public:
                 {
                     // locked shared, set writer pending bit
 
-                    std::uint32_t newst = st | 0x4000'0000;
+                    std::uint32_t newst = st | writer_pending;
                     state_.compare_exchange_weak( st, newst, std::memory_order_relaxed, std::memory_order_relaxed );
                 }
 
@@ -133,19 +231,19 @@ public:
 
                 for( ;; )
                 {
-                    if( st & 0x8000'0000 )
+                    if( st & locked_exclusive )
                     {
                         // locked exclusive, nothing to do
                         break;
                     }
-                    else if( ( st & 0x3FFF'FFFF ) == 0 )
+                    else if( ( st & reader_mask ) == 0 )
                     {
                         // lock free, try to take it
 
-                        std::uint32_t newst = 0x8000'0000;
+                        std::uint32_t newst = locked_exclusive | ( st & waiters );
                         if( state_.compare_exchange_weak( st, newst, std::memory_order_acquire, std::memory_order_relaxed ) ) return;
                     }
-                    else if( ( st & 0x4000'0000 ) == 0 )
+                    else if( ( st & writer_pending ) == 0 )
                     {
                         // writer pending bit already clear, nothing to do
                         break;
@@ -154,21 +252,40 @@ public:
                     {
                         // clear writer pending bit
 
-                        std::uint32_t newst = st & ~0x4000'0000u;
+                        std::uint32_t newst = st & ~writer_pending;
                         if( state_.compare_exchange_weak( st, newst, std::memory_order_relaxed, std::memory_order_relaxed ) ) break;
                     }
                 }
             }
 
-            boost::detail::sp_thread_sleep();
+            wait( []( std::uint32_t st ){ return ( st & ( locked_exclusive | reader_mask ) ) != 0; } );
         }
     }
 
     void unlock() noexcept
     {
         // pre: locked exclusive, not locked shared
-        state_.store( 0, std::memory_order_release );
+
+        if constexpr( Park )
+        {
+            if( state_.exchange( 0, std::memory_order_release ) & waiters )
+            {
+                wake_waiters();
+            }
+        }
+        else
+        {
+            state_.store( 0, std::memory_order_release );
+        }
     }
 };
 
+using rw_spinlock = basic_rw_spinlock<false>;
+
+#if defined(__linux__)
+
+using parking_rw_spinlock = basic_rw_spinlock<true>;
+
+#endif
+
 #endif // RW_SPINLOCK_HPP_INCLUDED
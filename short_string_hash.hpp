@@ -0,0 +1,141 @@
+#ifndef SHORT_STRING_HASH_HPP_INCLUDED
+#define SHORT_STRING_HASH_HPP_INCLUDED
+
+// Copyright 2026 agent
+// Distributed under the Boost Software License, Version 1.0.
+// https://www.boost.org/LICENSE_1_0.txt
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+// A string hash tuned for short keys (1-32 bytes, as most words are).
+//
+// Keys are read with at most four unaligned loads, which overlap for lengths
+// that are not a multiple of the load size, so there is no per-byte tail
+// loop; longer keys are consumed 16 bytes at a time. Each step combines two
+// 64-bit words with a 64x64->128 multiply folded to 64 bits, and the result
+// is a full avalanche, which is declared with is_avalanching so that
+// boost::unordered and cfoa::table skip their own post-mixing.
+
+class short_string_hash
+{
+private:
+
+    static constexpr std::uint64_t k0 = 0xa0761d6478bd642fULL;
+    static constexpr std::uint64_t k1 = 0xe7037ed1a0b428dbULL;
+    static constexpr std::uint64_t k2 = 0x8ebc6af09c88c6e3ULL;
+
+    static std::uint64_t mulx( std::uint64_t x, std::uint64_t y ) noexcept
+    {
+#if defined(__SIZEOF_INT128__)
+
+        __uint128_t r = static_cast<__uint128_t>( x ) * y;
+        return static_cast<std::uint64_t>( r ) ^ static_cast<std::uint64_t>( r >> 64 );
+
+#elif defined(_MSC_VER) && defined(_M_X64)
+
+        std::uint64_t hi;
+        std::uint64_t lo = _umul128( x, y, &hi );
+        return lo ^ hi;
+
+#else
+
+        std::uint64_t x1 = x >> 32, x0 = x & 0xFFFFFFFFu;
+        std::uint64_t y1 = y >> 32, y0 = y & 0xFFFFFFFFu;
+
+        std::uint64_t p00 = x0 * y0, p01 = x0 * y1, p10 = x1 * y0, p11 = x1 * y1;
+        std::uint64_t mid = ( p00 >> 32 ) + ( p01 & 0xFFFFFFFFu ) + ( p10 & 0xFFFFFFFFu );
+
+        std::uint64_t lo = ( mid << 32 ) | ( p00 & 0xFFFFFFFFu );
+        std::uint64_t hi = p11 + ( p01 >> 32 ) + ( p10 >> 32 ) + ( mid >> 32 );
+
+        return lo ^ hi;
+
+#endif
+    }
+
+    static std::uint64_t read64( unsigned char const* p ) noexcept
+    {
+        std::uint64_t r;
+        std::memcpy( &r, p, 8 );
+        return r;
+    }
+
+    static std::uint64_t read32( unsigned char const* p ) noexcept
+    {
+        std::uint32_t r;
+        std::memcpy( &r, p, 4 );
+        return r;
+    }
+
+public:
+
+    using is_avalanching = void;
+    using is_transparent = void;
+
+    std::size_t operator()( std::string_view x ) const noexcept
+    {
+        auto p = reinterpret_cast<unsigned char const*>( x.data() );
+        std::size_t n = x.size();
+
+        std::uint64_t a, b;
+        std::uint64_t seed = k0 ^ n;
+
+        if( n <= 16 )
+        {
+            if( n >= 8 )
+            {
+                a = read64( p );
+                b = read64( p + n - 8 );
+            }
+            else if( n >= 4 )
+            {
+                a = read32( p );
+                b = read32( p + n - 4 );
+            }
+            else if( n > 0 )
+            {
+                // first, middle and last byte; all three coincide for n == 1
+                a = ( std::uint64_t( p[ 0 ] ) << 16 ) | ( std::uint64_t( p[ n >> 1 ] ) << 8 ) | p[ n - 1 ];
+                b = 0;
+            }
+            else
+            {
+                a = b = 0;
+            }
+        }
+        else if( n <= 32 )
+        {
+            seed = mulx( read64( p ) ^ k1, read64( p + 8 ) ^ seed );
+
+            a = read64( p + n - 16 );
+            b = read64( p + n - 8 );
+        }
+        else
+        {
+            std::size_t i = n;
+
+            do
+            {
+                seed = mulx( read64( p ) ^ k1, read64( p + 8 ) ^ seed );
+
+                p += 16;
+                i -= 16;
+            }
+            while( i > 16 );
+
+            a = read64( p + i - 16 );
+            b = read64( p + i - 8 );
+        }
+
+        return static_cast<std::size_t>( mulx( k1 ^ n, mulx( a ^ k1, b ^ seed ) ^ k2 ) );
+    }
+};
+
+#endif // #ifndef SHORT_STRING_HASH_HPP_INCLUDED